@@ -1,513 +1,4147 @@
+#ifndef BAG_H
+#define BAG_H
+
+#include "bag_file.h"
+#include "bag_pool.h"
+#include "bag_search.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <iomanip>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdint.h>
 #include <stdlib.h>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* bag을 B-tree로 구현한 template class 입니다. bag이기 때문에 같은 데이터를
+ * 중복해서 저장할수 있습니다. 노드 하나가 가질수 있는 데이터의 수(fanout)는
+ * 템플릿 인자 MINIMUM으로 컴파일 타임에 정합니다.
+ *
+ * 노드는 리프노드(leaf_node)와 내부노드(internal_node)로 나뉘며, 리프노드는
+ * 데이터만 가지고 자식 포인터 배열은 내부노드에만 있습니다. 노드는 Alloc으로
+ * 할당한 트리별 slab(bag_pool)에서 받아오기 때문에 clear()와 소멸자는 트리
+ * 전체를 한번에 해제할 수 있습니다(다른 bag과 노드를 공유하지 않을때).
+ *
+ * 데이터의 순서는 템플릿 인자 Compare(기본값 std::less<Item>)로 정합니다.
+ * Compare(a, b)와 Compare(b, a)가 모두 false인 두 데이터를 같은 데이터로
+ * 세므로 operator==는 필요하지 않습니다. std::less<>처럼 transparent 비교자를
+ * 주면 count(), lower_bound() 등의 검색에 Item이 아닌 타입을 그대로 넘길수
+ * 있습니다.
+ *
+ * 노드 안에서 데이터의 위치를 찾을때는 bag_search.h의 검색 커널을 사용합니다.
+ * std::less로 비교하는 정수와 실수 타입은 SIMD 커널이, 그 외의 타입은 이진
+ * 검색 커널이 사용됩니다. std::string을 바이트 순서로 비교하면 노드가 각
+ * 데이터의 앞 8바이트를 정수(prefix key)로 함께 저장하고, 대부분의 비교를
+ * 문자열의 힙 메모리를 읽지 않고 끝냅니다. OPTIONS에 BAG_PREFIX_COMPRESSION을
+ * 주면 노드의 데이터가 공유하는 앞부분을 빼고 prefix key를 만들기 때문에 URL
+ * 처럼 앞부분이 긴 문자열에서도 prefix key가 데이터를 구분합니다.
+ *
+ * OPTIONS에 BAG_RUN_LENGTH를 주면 같은 데이터를 한번만 저장하고 개수를 따로
+ * 세는 run-length 모드가 됩니다. 이 모드에서는 이미 있는 데이터의 insert()와
+ * erase_one()이 개수만 바꾸고, count()는 루트에서 리프까지 한번만 내려갑니다.
+ * 같은 데이터가 많이 반복되는 경우에 메모리와 시간을 모두 줄일수 있습니다.
+ *
+ * bag의 데이터는 const_iterator로 오름차순으로 순회할수 있습니다.
+ * lower_bound(), upper_bound(), equal_range()로 특정 범위의 시작 위치를 찾을수
+ * 있고, count_range()는 범위 안의 데이터 수를 셉니다.
+ *
+ * OPTIONS에 BAG_ORDER_STATS를 주면 내부노드가 각 자식 서브트리의 데이터 수를
+ * 함께 저장합니다. 이 수를 이용해서 rank(), select(), quantile()이 루트에서
+ * 리프까지 한번만 내려가서 답을 구하고, count()와 count_range()도 범위의
+ * 크기와 상관없이 두번만 내려갑니다. 서브트리의 데이터 수는 삽입과 삭제가
+ * 지나가는 경로에서만 갱신되므로 insert()와 erase의 복잡도는 그대로입니다.
+ *
+ * 많은 데이터를 한번에 넣을때는 범위 생성자나 assign()을 사용합니다. 데이터를
+ * 정렬한 후(정렬되어 있지 않다면 여러 스레드로 정렬한다) 리프노드부터 위로
+ * 한층씩 노드를 채워서 O(n)에 트리를 만들기 때문에 노드의 분할이 일어나지
+ * 않습니다. insert_bulk()는 넣을 데이터가 많으면 기존 데이터와 merge해서 트리를
+ * 다시 만듭니다.
+ *
+ * count_batch()와 contains_batch()는 많은 데이터를 한번에 찾습니다. 여러
+ * 검색을 한층씩 번갈아 진행하면서 각 검색이 다음에 읽을 노드를 미리
+ * prefetch 하므로, 한 검색이 캐시 미스를 기다리는 동안 다른 검색의 비교가
+ * 진행됩니다. bag_batch_options로 데이터를 정렬한 순서로 찾거나 여러
+ * 스레드에 나눠 찾을수 있습니다.
+ *
+ * merge(), union_with(), intersect(), difference()는 두 bag을 multiset으로
+ * 합칩니다. 같은 데이터의 개수는 각각 두 개수의 합, 큰 값, 작은 값, 차(0
+ * 이상)가 됩니다. 두 트리를 오름차순으로 함께 순회하며 결과를 모은 후 assign()
+ * 처럼 트리를 다시 만들기 때문에 O(n + m) 입니다.
+ *
+ * save()는 bag을 페이지 단위의 파일 형식(bag_file.h)으로 저장합니다. 저장한
+ * 파일은 mapped_bag(mapped_bag.h)으로 mmap 해서 역직렬화 없이 바로 검색할수
+ * 있습니다.
+ *
+ * bag의 복사는 O(1) 입니다. 복사본은 노드를 복사하지 않고 원본과 함께 가리키며,
+ * 노드는 자신을 가리키는 부모와 bag의 수를 참조 수로 셉니다. insert()와
+ * erase는 내려가는 경로에서 다른 bag과 공유하는 노드를 만나면 그 노드만 복사해서
+ * 바꾸므로(path copying), 한번의 수정으로 복사되는 노드는 트리의 높이 정도
+ * 입니다. 따라서 snapshot()으로 만든 복사본은 원본이 바뀌어도 복사한 시점의
+ * 데이터를 그대로 가집니다. 공유하는 노드는 어느 bag도 바꾸지 않으므로, 한
+ * 스레드가 bag을 수정하는 동안 다른 스레드가 그 snapshot을 읽을수 있습니다. 같은
+ * bag 객체를 여러 스레드가 동시에 사용하는 것은 여전히 안전하지 않습니다.
+ *
+ * stats()는 트리의 높이, 노드 수, 노드가 채워진 비율, 메모리 사용량을 구합니다.
+ * OPTIONS에 BAG_INSTRUMENT를 주면 연산마다 방문한 노드 수와 분할, 빌려오기,
+ * merge, 노드 할당의 횟수를 세고 counters()로 꺼낼수 있습니다. 이 옵션이 없으면
+ * 세는 코드가 모두 컴파일되지 않으므로 비용이 없습니다.
+ *
+ * show_contents()는 트리를 임의의 ostream에 가로로 누운 텍스트, Graphviz DOT,
+ * JSON, 또는 층별 요약으로 출력합니다. 큰 트리는 bag_dump_options의 깊이와
+ * 노드 수 제한으로 위쪽 층만 출력하고, 생략한 서브트리는 "..."로 표시합니다.
+ * 출력은 버퍼에 모아서 큰 단위로 쓰기 때문에 데이터마다 flush하지 않습니다. */
+
+// bag_options는 bag의 저장 방식을 고르는 플래그입니다. 템플릿 인자 OPTIONS에
+// 비트 OR로 조합해서 넘깁니다.
+enum bag_options {
+    BAG_DEFAULT = 0,           // 같은 데이터를 각각 따로 저장한다
+    BAG_RUN_LENGTH = 1,        // 같은 데이터를 한번만 저장하고 개수를 센다
+    BAG_ORDER_STATS = 2,       // 서브트리의 데이터 수를 저장해서 순위를 구한다
+    BAG_INSTRUMENT = 4,        // 연산과 트리 재구성의 횟수를 센다(counters())
+    BAG_PREFIX_COMPRESSION = 8 // 문자열 prefix key에서 공통 앞부분을 뺀다
+};
+
+// bag_counters는 BAG_INSTRUMENT 모드의 bag이 세는 횟수들입니다. 모두 bag을
+// 만들거나 reset_counters()를 호출한 후부터 센 값입니다.
+struct bag_counters {
+    uint64_t insert_calls;  // insert(), emplace() 호출 수
+    uint64_t insert_visits; // 삽입이 방문한 노드 수
+    uint64_t erase_calls;   // erase_one(), erase_all() 호출 수
+    uint64_t erase_visits;  // 삭제가 방문한 노드 수
+    uint64_t lookup_calls;  // count(), rank() 호출 수
+    uint64_t lookup_visits; // 검색이 방문한 노드 수
+    uint64_t splits;        // fix_excess()로 노드를 분할한 횟수
+    uint64_t shortages;     // fix_shortage() 호출 수. 아래 셋의 합
+    uint64_t borrow_left;   // 왼쪽 형제에게 데이터를 빌려온 횟수
+    uint64_t borrow_right;  // 오른쪽 형제에게 데이터를 빌려온 횟수
+    uint64_t merges;        // merge_child()로 두 자식을 합친 횟수
+    uint64_t node_allocs;   // pool에서 노드를 할당한 횟수
+    uint64_t node_copies;   // snapshot과 공유하던 노드를 복사한 횟수
+};
+
+// bag_stats는 stats()가 구하는 트리의 구조입니다.
+struct bag_stats {
+    size_t size;           // 데이터의 수
+    size_t height;         // 트리의 층 수. 비어있다면 0
+    size_t leaf_nodes;     // 리프노드의 수
+    size_t internal_nodes; // 내부노드의 수
+    size_t slots;          // 노드에 저장된 데이터 자리의 수. run-length
+                           // 모드에서는 size보다 적을수 있다
+    double fill_factor;    // slots / (노드 수 * 노드의 최대 데이터 수)
+    size_t shared_nodes;   // 다른 bag과 공유하는 노드의 수
+    size_t node_bytes;     // 노드들이 차지하는 메모리
+    size_t pool_bytes;     // pool이 할당받은 slab의 메모리. snapshot과 공유하는
+                           // pool이라면 그 bag들의 노드도 포함된다
+};
+
+// bag_dump_format은 show_contents()의 출력 형식입니다.
+enum bag_dump_format {
+    BAG_DUMP_TEXT,   // 트리를 왼쪽으로 눕혀서 들여쓰기로 출력한다
+    BAG_DUMP_DOT,    // Graphviz의 dot으로 그릴수 있는 digraph
+    BAG_DUMP_JSON,   // 노드마다 keys와 children을 가지는 JSON
+    BAG_DUMP_SUMMARY // 층별 노드 수, 데이터 수, 채워진 비율
+};
+
+// bag_dump_options는 show_contents()의 출력 형식과 출력할 범위입니다.
+// max_depth보다 깊은 노드와 max_nodes개 이후의 노드는 출력하지 않고 생략
+// 표시만 합니다. order-statistic 모드에서는 생략한 데이터의 수도 출력합니다.
+struct bag_dump_options {
+    bag_dump_format format;
+    size_t max_depth; // 출력할 층의 수. 0이면 루트도 생략한다
+    size_t max_nodes; // 출력할 노드의 수
+
+    bag_dump_options(bag_dump_format format = BAG_DUMP_TEXT,
+                     size_t max_depth = size_t(-1),
+                     size_t max_nodes = size_t(-1))
+        : format(format), max_depth(max_depth), max_nodes(max_nodes) {}
+};
+
+// bag_batch_options는 count_batch()와 contains_batch()의 실행 방법입니다.
+struct bag_batch_options {
+    bool sort_keys; // 데이터를 정렬한 순서로 찾아서 이웃한 검색이 같은 경로를
+                    // 지나게 한다. 결과는 원래 순서로 쓴다
+    size_t threads; // 많은 데이터를 나눠 찾을 스레드의 수. 0이면 하드웨어
+                    // 스레드 수
+
+    bag_batch_options(bool sort_keys = false, size_t threads = 1)
+        : sort_keys(sort_keys), threads(threads) {}
+};
+
+// bag_node_multiplicity는 run-length 모드에서 노드의 각 데이터가 몇번 들어
+// 있는지를 저장합니다. run-length 모드가 아니면 빈 클래스이므로 노드의 크기가
+// 늘어나지 않고, 모든 데이터의 개수는 1로 취급됩니다.
+template <size_t SLOTS, bool RUN_LENGTH> struct bag_node_multiplicity {
+    size_t multiplicity(size_t) const { return 1; }
+    void set_multiplicity(size_t, size_t) {}
+};
+
+template <size_t SLOTS> struct bag_node_multiplicity<SLOTS, true> {
+    size_t mult[SLOTS];
+
+    size_t multiplicity(size_t i) const { return mult[i]; }
+    void set_multiplicity(size_t i, size_t m) { mult[i] = m; }
+};
+
+// bag_node_child_totals는 order-statistic 모드에서 내부노드의 각 자식
+// 서브트리에 들어있는 데이터 수를 저장합니다. run-length 모드의 개수도 모두
+// 포함한 수입니다. order-statistic 모드가 아니면 빈 클래스입니다.
+template <size_t SLOTS, bool ORDER_STATS> struct bag_node_child_totals {
+    size_t child_total(size_t) const { return 0; }
+    void set_child_total(size_t, size_t) {}
+};
+
+template <size_t SLOTS> struct bag_node_child_totals<SLOTS, true> {
+    size_t total[SLOTS];
+
+    size_t child_total(size_t i) const { return total[i]; }
+    void set_child_total(size_t i, size_t t) { total[i] = t; }
+};
+
+// bag_node_keys는 std::string 데이터의 prefix key(bag_prefix_key())를 노드
+// 안에 저장합니다. prefix key를 사용하지 않는 bag에서는 빈 클래스입니다.
+// COMPRESS이면 노드의 모든 데이터가 공유하는 앞부분 key_skip 바이트를 빼고
+// 그 다음 8바이트로 prefix key를 만들기 때문에, URL이나 경로처럼 앞부분이
+// 긴 문자열도 대부분 정수 비교로 구분됩니다.
+template <size_t SLOTS, bool PREFIX, bool COMPRESS> struct bag_node_keys {
+    uint64_t prefix_key(size_t) const { return 0; }
+    void set_prefix_key(size_t, uint64_t) {}
+    template <class Item>
+    void update_prefix_key(const Item *, size_t, size_t) {}
+    template <class Item> void reset_prefix_keys(const Item *, size_t) {}
+};
+
+template <size_t SLOTS, bool COMPRESS>
+struct bag_node_keys<SLOTS, true, COMPRESS> {
+    size_t key_skip;     // 모든 데이터가 공유하는 앞부분의 길이
+    uint64_t key[SLOTS]; // key[i]는 data[i]의 key_skip 뒤의 prefix key
+
+    bag_node_keys() : key_skip(0) {}
+
+    uint64_t prefix_key(size_t i) const { return key[i]; }
+    void set_prefix_key(size_t i, uint64_t k) { key[i] = k; }
+
+    // update_prefix_key()는 data[i]가 바뀐 후 key[i]를 다시 구하는
+    // 함수입니다. data[i]가 앞부분 key_skip 바이트를 다른 데이터와 공유하지
+    // 않으면 reset_prefix_keys()로 모든 key를 다시 구한다.
+    // Pre : i < count, data[0..count)는 오름차순이다.
+    // Post : key[i]가 data[i]의 prefix key가 된다.
+    void update_prefix_key(const std::string *data, size_t count, size_t i);
+
+    // reset_prefix_keys()는 COMPRESS일때 key_skip을 data[0]과 data[count-1]의
+    // 공통 앞부분 길이로 다시 정하고 모든 key를 구하는 함수입니다. 정렬되어
+    // 있으므로 두 데이터의 공통 앞부분은 모든 데이터의 공통 앞부분이다.
+    // Pre : data[0..count)는 오름차순이다.
+    // Post : key[0..count)가 data[0..count)의 prefix key가 된다.
+    void reset_prefix_keys(const std::string *data, size_t count);
+};
+
+template <size_t SLOTS, bool COMPRESS>
+void bag_node_keys<SLOTS, true, COMPRESS>::update_prefix_key(
+    const std::string *data, size_t count, size_t i) {
+    assert(i < count); // Precondition
+
+    if (COMPRESS && key_skip > 0) {
+        // 비교할 다른 데이터가 없거나 앞부분이 다르면 key_skip을 다시 정한다
+        const std::string &other = data[i == 0 ? 1 : 0];
+        if (count < 2 ||
+            data[i].compare(0, key_skip, other, 0, key_skip) != 0) {
+            reset_prefix_keys(data, count);
+            return;
+        }
+    }
+    key[i] = bag_prefix_key(data[i], key_skip);
+}
+
+template <size_t SLOTS, bool COMPRESS>
+void bag_node_keys<SLOTS, true, COMPRESS>::reset_prefix_keys(
+    const std::string *data, size_t count) {
+    if (!COMPRESS)
+        return;
+
+    key_skip = 0;
+    if (count > 1) {
+        const std::string &first = data[0];
+        const std::string &last = data[count - 1];
+        size_t length = std::min(first.size(), last.size());
+        while (key_skip < length && first[key_skip] == last[key_skip])
+            key_skip++;
+    }
+    for (size_t i = 0; i < count; i++)
+        key[i] = bag_prefix_key(data[i], key_skip);
+}
+
+// bag_instrument는 bag_counters를 세는 부분입니다. BAG_INSTRUMENT 모드가
+// 아니면 add()가 아무 일도 하지 않으므로 세는 코드가 모두 사라집니다. 검색도
+// 횟수를 세므로 값은 mutable 입니다.
+template <bool INSTRUMENT> struct bag_instrument {
+    void add(uint64_t bag_counters::*, uint64_t = 1) const {}
+    bag_counters get() const { return bag_counters(); }
+    void reset() {}
+};
+
+template <> struct bag_instrument<true> {
+    mutable bag_counters counters;
+
+    bag_instrument() : counters() {}
+    void add(uint64_t bag_counters::*field, uint64_t n = 1) const {
+        counters.*field += n;
+    }
+    bag_counters get() const { return counters; }
+    void reset() { counters = bag_counters(); }
+};
+
+// bag_default_minimum은 MINIMUM을 지정하지 않았을때 사용하는 기본값입니다.
+// 노드의 data[] 배열이 캐시 라인 CACHE_LINES 개를 채우도록 MINIMUM을 정합니다.
+// 따라서 Item이 작을수록 노드가 넓어지고 트리의 높이가 낮아집니다.
+template <class Item> struct bag_default_minimum {
+    static const size_t CACHE_LINE = 64;
+    static const size_t CACHE_LINES = 4;
+    static const size_t SLOTS = CACHE_LINE * CACHE_LINES / sizeof(Item);
+
+    // data[]는 MAXIMUM + 1 = 2 * MINIMUM + 1 칸이므로 이에 맞춰 계산한다
+    static const size_t value = (SLOTS >= 3) ? (SLOTS - 1) / 2 : 1;
+};
+
+template <class Item, size_t MINIMUM = bag_default_minimum<Item>::value,
+          class Alloc = std::allocator<Item>, unsigned OPTIONS = BAG_DEFAULT,
+          class Compare = std::less<Item>>
+class bag {
+  public:
+    // Default Constructor
+    bag();
+
+    // Constructor. 노드를 할당할때 alloc을 사용한다.
+    explicit bag(const Alloc &alloc);
+
+    // Constructor. 데이터를 compare의 순서로 저장한다. compare(a, b)와
+    // compare(b, a)가 모두 false인 두 데이터는 같은 데이터로 센다.
+    explicit bag(const Compare &compare, const Alloc &alloc = Alloc());
+
+    // Copy Constructor. 노드를 복사하지 않고 source와 공유하므로 O(1)에
+    // 처리된다. 이후 둘 중 하나가 바뀌면 바뀌는 경로의 노드만 복사된다.
+    bag(const bag &source);
+
+    // Move Constructor. source의 트리를 그대로 가져오고 source는 빈 bag이
+    // 된다.
+    bag(bag &&source) noexcept;
+
+    // Range Constructor. [first, last)의 데이터로 bag을 만든다. assign()과
+    // 같은 방법으로 트리를 한번에 만든다.
+    template <class InputIterator>
+    bag(InputIterator first, InputIterator last, const Alloc &alloc = Alloc());
+
+    // Destructor
+    ~bag();
+
+    // Assignment Operator. 복사 생성자처럼 source와 노드를 공유한다.
+    bag &operator=(const bag &source);
+
+    // Move Assignment Operator. 기존 데이터를 비운 후 source의 트리를 그대로
+    // 가져오고 source는 빈 bag이 된다.
+    bag &operator=(bag &&source);
+
+    // snapshot() 함수는 현재 bag의 읽기용 복사본을 만드는 함수입니다. 노드를
+    // 공유하므로 O(1)에 처리되며, 이후 이 bag이 바뀌어도 복사본의 데이터는
+    // 바뀌지 않습니다. 복사본은 다른 스레드에서 읽을수 있습니다.
+    // Pre : None.
+    // Post : 현재 데이터를 가지는 bag을 반환.
+    bag snapshot() const;
+
+    // count() 함수는 현재 bag에 target이 몇개 존재하는지 반환하는 함수입니다.
+    // Pre : None.
+    // Post : bag에 있는 target의 개수를 반환. 없을 시 0 반환.
+    size_t count(const Item &target) const;
+
+    // Compare가 std::less<>처럼 transparent 비교자라면 count(), rank(),
+    // lower_bound(), upper_bound(), equal_range(), count_range()는 Item으로
+    // 바꾸지 않고 비교자로 Item과 비교할수 있는 타입으로도 찾을수 있다.
+    // string_bag은 std::string_view나 const char *로 찾을때 문자열을 만들지
+    // 않는다.
+    template <class Key, class C = Compare,
+              class = typename C::is_transparent>
+    size_t count(const Key &target) const;
+
+    // count_batch() 함수는 keys[0..n)의 개수를 각각 세는 함수입니다. 검색을
+    // BATCH_GROUP개씩 묶어 한층씩 번갈아 내려가면서 다음 노드를 prefetch
+    // 합니다. BAG_INSTRUMENT 모드에서는 스레드를 나누지 않습니다.
+    // Pre : keys와 counts는 n개의 원소를 가진다.
+    // Post : counts[i]는 bag에 있는 keys[i]의 개수이다.
+    void count_batch(const Item *keys, size_t n, size_t *counts,
+                     const bag_batch_options &options =
+                         bag_batch_options()) const;
+
+    // contains_batch() 함수는 keys[0..n)이 bag에 있는지 각각 확인하는
+    // 함수입니다. count_batch()와 같은 방법으로 찾지만 데이터를 찾은 노드에서
+    // 바로 끝난다.
+    // Pre : keys와 found는 n개의 원소를 가진다.
+    // Post : found[i]는 keys[i]가 bag에 있으면 true이다.
+    void contains_batch(const Item *keys, size_t n, bool *found,
+                        const bag_batch_options &options =
+                            bag_batch_options()) const;
+
+    // insert() 함수는 현재 bag에 entry를 삽입하는 함수입니다. rvalue로 넘긴
+    // entry는 복사하지 않고 리프노드까지 move 합니다. 노드 안에서 데이터를
+    // 밀거나 분할할때도 데이터를 move 하므로 Item의 복사는 일어나지 않습니다.
+    // Pre : None.
+    // Post : bag에 enrty가 추가된다.
+    void insert(const Item &entry);
+    void insert(Item &&entry);
+
+    // emplace() 함수는 args로 Item을 만들어 삽입하는 함수입니다. 만든 Item은
+    // insert(Item &&)처럼 복사 없이 자리를 찾아간다.
+    // Pre : Item(args...)가 가능하다.
+    // Post : bag에 Item(args...)가 추가된다.
+    template <class... Args> void emplace(Args &&...args);
+
+    // erase_one 함수는 현재 bag에서 target 하나를 제거하는 함수입니다.
+    // target을 찾으면서 바로 삭제하므로 트리를 한번만 내려갑니다.
+    // Pre : None.
+    // Post : bag에 taget이 존재하면 삭제후 true 반환.
+    //        target이 존재하지 않으면 false 반환.
+    bool erase_one(const Item &target);
+
+    // erase_all 함수는 현재 bag에서 target을 모두 제거하는 함수입니다.
+    // run-length 모드에서는 target의 자리 하나만 삭제하므로 트리를 한번만
+    // 내려갑니다. 그 외에는 count()처럼 target이 있을수 있는 자식으로만
+    // 내려가면서 한번에 모두 제거하고, 모자라게 된 노드는 돌아오면서
+    // 고칩니다. target만 들어있는 서브트리는 방문하지 않고 통째로 해제합니다.
+    // Pre : None.
+    // Post : bag에서 target을 모두 삭제후 삭제한 개수를 반환.
+    size_t erase_all(const Item &target);
+
+    // assign() 함수는 bag의 데이터를 [first, last)의 데이터로 바꾸는
+    // 함수입니다. 데이터를 정렬한 후 리프노드부터 한층씩 노드를 채워서 트리를
+    // O(n)에 만듭니다. 정렬되어 있지 않은 데이터는 먼저 여러 스레드로
+    // 정렬합니다. fill은 각 노드를 MAXIMUM의 몇 비율까지 채울지를 정하며, 이후
+    // 삽입이 많다면 1보다 작게 주어서 노드의 분할을 줄일수 있습니다.
+    // Pre : 0 < fill <= 1
+    // Post : bag에 [first, last)의 데이터만 들어있다. 각 노드의 데이터 수는
+    //        MINIMUM 이상이면서 fill * MAXIMUM에 가깝게 채워진다.
+    template <class InputIterator>
+    void assign(InputIterator first, InputIterator last, double fill = 1.0);
+
+    // insert_bulk() 함수는 [first, last)의 데이터를 모두 삽입하는 함수입니다.
+    // 넣을 데이터가 현재 데이터의 1/BULK_REBUILD_RATIO 이상이면 기존 데이터와
+    // merge해서 assign()처럼 트리를 다시 만들고, 그보다 적으면 정렬된 순서로
+    // 하나씩 삽입합니다. fill은 트리를 다시 만들때만 사용됩니다.
+    // Pre : 0 < fill <= 1
+    // Post : [first, last)의 데이터가 모두 bag에 추가된다.
+    template <class InputIterator>
+    void insert_bulk(InputIterator first, InputIterator last,
+                     double fill = 1.0);
+
+    // merge() 함수는 other의 데이터를 모두 현재 bag으로 옮기는 함수입니다.
+    // 한쪽이 비어있거나 훨씬 작으면 큰 쪽의 트리를 그대로 가져와서 작은
+    // 쪽의 데이터만 삽입합니다.
+    // Pre : None.
+    // Post : 각 데이터의 개수가 두 bag의 개수의 합이 되고 other는 비어있다.
+    void merge(bag &&other);
+
+    // union_with() 함수는 현재 bag을 other와의 합집합으로 만드는 함수입니다.
+    // Pre : None.
+    // Post : 각 데이터의 개수가 두 bag의 개수 중 큰 값이 된다.
+    void union_with(const bag &other);
+
+    // intersect() 함수는 현재 bag을 other와의 교집합으로 만드는 함수입니다.
+    // Pre : None.
+    // Post : 각 데이터의 개수가 두 bag의 개수 중 작은 값이 된다.
+    void intersect(const bag &other);
+
+    // difference() 함수는 현재 bag에서 other의 데이터를 빼는 함수입니다.
+    // Pre : None.
+    // Post : 각 데이터의 개수가 현재 개수에서 other의 개수를 뺀 값이 된다.
+    //        other의 개수가 더 많다면 0이 된다.
+    void difference(const bag &other);
+
+    // split() 함수는 key 이상인 데이터를 현재 bag에서 떼어내는 함수입니다.
+    // key를 찾아 내려가는 경로의 노드만 나누고 경로 양쪽의 서브트리는 그대로
+    // 옮긴 후, 나눠진 조각들을 join()과 같은 방법으로 붙이므로 트리의 높이에
+    // 비례하는 노드만 바뀝니다. 떼어낸 bag은 현재 bag과 pool을 공유합니다.
+    // order-statistic 모드가 아니면 size()를 구하기 위해 한쪽의 노드를 센다.
+    // Pre : None.
+    // Post : key보다 작은 데이터만 남고 key 이상인 데이터를 가진 bag을 반환.
+    bag split(const Item &key);
+
+    // join() 함수는 right의 데이터를 현재 bag의 뒤에 이어붙이는 함수입니다.
+    // 현재 bag의 가장 큰 데이터를 떼어 두 트리 사이에 두고 낮은 트리를 높은
+    // 트리의 가장자리에 붙이므로 O(log n) 입니다. split()으로 떼어낸 bag처럼
+    // right의 pool을 다른 bag이 함께 가지고 있으면 현재 bag의 노드를 그
+    // pool로 옮깁니다. 두 bag의 pool을 모두 다른 bag이 함께 가지고 있어서
+    // 노드를 옮길수 없으면 merge()처럼 O(n + m)에 합칩니다.
+    // Pre : 현재 bag의 데이터는 모두 right의 데이터보다 크지 않다.
+    //       run-length 모드에서는 모두 작다.
+    // Post : 두 bag의 데이터가 모두 현재 bag에 있고 right는 비어있다.
+    void join(bag &&right);
+
+    // show_contents() 함수는 bag을 구현하고 있는 B-tree의 현재 상태를 가로로
+    // 출력하는 함수입니다.
+    // Pre : None.
+    // Post : 화면에 B-tree가 가로로 출력된다.
+    void show_contents() const;
+
+    // show_contents() 함수는 B-tree를 options의 형식과 범위로 out에 출력하는
+    // 함수입니다.
+    // Pre : None.
+    // Post : 출력할 범위의 노드가 out에 쓰여지고 out이 flush 된다.
+    void show_contents(std::ostream &out,
+                       const bag_dump_options &options) const;
+
+    // clear() 함수는 현재 bag을 빈 bag으로 만드는 함수입니다.
+    // Pre : None.
+    // Post : bag에 동적 할당된 모든 자원을 free 시킨 후 bag을 비운다.
+    //        노드를 공유하는 bag이 없다면 slab 단위로 한번에 해제되고, 있다면
+    //        공유하지 않는 노드만 해제된다.
+    void clear();
+
+    // save() 함수는 bag을 path에 페이지 형식으로 저장하는 함수입니다. 같은
+    // 데이터는 한번만 저장하고 개수를 기록합니다. 저장한 파일은
+    // mapped_bag::open_mapped()로 열수 있습니다.
+    // Pre : Item은 trivially copyable 타입. mapped_bag은 operator<로 찾으므로
+    //       Compare는 std::less<Item>이나 std::less<>여야 한다.
+    // Post : 파일을 모두 썼다면 true 반환. 실패하면 false 반환.
+    bool save(const char *path) const;
+
+    // get_allocator() 함수는 bag이 노드를 할당할때 사용하는 allocator를
+    // 반환하는 함수입니다.
+    // Pre : None.
+    // Post : allocator의 복사본을 반환.
+    Alloc get_allocator() const;
+
+    // key_comp() 함수는 데이터의 순서를 정하는 비교자를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : 비교자의 복사본을 반환.
+    Compare key_comp() const;
+
+    // size() 함수는 bag에 들어있는 데이터의 수를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : 같은 데이터도 각각 세어서 반환.
+    size_t size() const;
+
+    // empty() 함수는 bag이 비어있는지 확인하는 함수입니다.
+    // Pre : None.
+    // Post : bag이 비어있으면 true 반환.
+    bool empty() const;
+
+    // rank() 함수는 target보다 작은 데이터의 수를 반환하는 함수입니다.
+    // OPTIONS에 BAG_ORDER_STATS가 있어야 사용할수 있습니다.
+    // Pre : None.
+    // Post : x < target 인 데이터 x의 수를 반환.
+    size_t rank(const Item &target) const;
+
+    template <class Key, class C = Compare,
+              class = typename C::is_transparent>
+    size_t rank(const Key &target) const;
+
+    // select() 함수는 오름차순으로 k번째(0부터 시작) 데이터를 반환하는
+    // 함수입니다. OPTIONS에 BAG_ORDER_STATS가 있어야 사용할수 있습니다.
+    // Pre : k < size()
+    // Post : 같은 데이터도 각각 세었을때 k번째 데이터를 반환.
+    const Item &select(size_t k) const;
+
+    // quantile() 함수는 q 분위수를 nearest-rank 방식으로 구하는 함수입니다.
+    // quantile(0.5)는 중앙값, quantile(0.99)는 p99가 됩니다. OPTIONS에
+    // BAG_ORDER_STATS가 있어야 사용할수 있습니다.
+    // Pre : !empty() && 0 <= q <= 1
+    // Post : select(ceil(q * size()) - 1)을 반환. q가 0이면 select(0) 반환.
+    const Item &quantile(double q) const;
+
+    // stats() 함수는 트리의 구조와 메모리 사용량을 구하는 함수입니다. 모든
+    // 노드를 방문하므로 O(노드 수) 입니다. Item이 따로 할당하는 메모리는
+    // 포함하지 않습니다.
+    // Pre : None.
+    // Post : 현재 트리의 bag_stats를 반환.
+    bag_stats stats() const;
+
+    // counters() 함수는 지금까지 센 연산과 트리 재구성의 횟수를 반환하는
+    // 함수입니다. OPTIONS에 BAG_INSTRUMENT가 있어야 사용할수 있습니다. 복사한
+    // bag은 0부터 다시 센다.
+    // Pre : None.
+    // Post : bag_counters의 복사본을 반환.
+    bag_counters counters() const;
+
+    // reset_counters() 함수는 센 횟수를 모두 0으로 만드는 함수입니다.
+    // OPTIONS에 BAG_INSTRUMENT가 있어야 사용할수 있습니다.
+    // Pre : None.
+    // Post : counters()의 모든 값이 0이 된다.
+    void reset_counters();
+
+  private:
+    static_assert(MINIMUM >= 1, "bag needs MINIMUM >= 1");
+
+    static const size_t MAXIMUM = 2 * MINIMUM;
+
+    static const bool RUN_LENGTH = (OPTIONS & BAG_RUN_LENGTH) != 0;
+    static const bool ORDER_STATS = (OPTIONS & BAG_ORDER_STATS) != 0;
+    static const bool INSTRUMENT = (OPTIONS & BAG_INSTRUMENT) != 0;
+
+    // std::string을 바이트 순서로 비교하면 노드가 prefix key를 함께 가진다
+    static const bool PREFIX_KEYS = bag_prefix_traits<Item, Compare>::value;
+    static const bool PREFIX_COMPRESSION =
+        PREFIX_KEYS && (OPTIONS & BAG_PREFIX_COMPRESSION) != 0;
+
+    // insert_bulk()는 넣을 데이터의 수에 이 값을 곱한 것이 현재 데이터의 수
+    // 이상이면 트리를 다시 만든다
+    static const size_t BULK_REBUILD_RATIO = 16;
+
+    // 이보다 적은 데이터는 스레드를 만들지 않고 정렬한다
+    static const size_t PARALLEL_SORT_MIN = 1 << 16;
+
+    // count_batch()에서 한층씩 번갈아 진행하는 검색의 수. 캐시 미스를 여러개
+    // 동시에 기다릴수 있을 만큼 크고, 경로가 레지스터와 L1에 남을 만큼 작다
+    static const size_t BATCH_GROUP = 16;
+
+    // count_batch()에서 스레드 하나가 맡을 최소 데이터 수
+    static const size_t PARALLEL_BATCH_MIN = 1 << 14;
+
+    // prefetch_node()가 미리 읽어올 최대 캐시 라인 수
+    static const size_t PREFETCH_LINES = 8;
+
+    // 대량 삽입에서 정렬된 데이터를 모아두는 버퍼
+    typedef std::vector<Item, Alloc> item_buffer;
+
+    // 노드 안에서 데이터의 위치를 찾는 검색 커널
+    typedef typename bag_search_traits<Item, Compare>::type search;
+
+    // node는 리프노드와 내부노드가 공통으로 가지는 부분입니다. run-length
+    // 모드에서는 data[i]의 개수를 multiplicity(i)로 가지고, PREFIX_KEYS이면
+    // data[i]의 prefix key를 prefix_key(i)로 가진다. refs는 이 노드를
+    // 가리키는 부모 노드와 bag의 수이며, 1보다 크면 다른 bag과 공유하는
+    // 노드이므로 바꾸지 않는다.
+    struct node : bag_node_multiplicity<MAXIMUM + 1, RUN_LENGTH>,
+                  bag_node_keys<MAXIMUM + 1, PREFIX_KEYS, PREFIX_COMPRESSION> {
+        std::atomic<size_t> refs;
+        bool leaf;         // 리프노드이면 true
+        size_t data_count; // 현재 노드에 저장하고 있는 데이터의 수
+        Item data[MAXIMUM + 1];
+
+        // insert_data()는 data[i]에 enrty를 삽입하는 함수입니다.
+        // Pre : i <= data_count
+        // Post : data[i]에 enrty를 삽입하고 개수를 mult로 한다. data[i]에 이미
+        //        아이템이 존재한다면 한칸씩 뒤로 민다. data_count는 1 증가.
+        void insert_data(size_t i, const Item &entry, size_t mult = 1);
+
+        void insert_data(size_t i, Item &&entry, size_t mult = 1);
+
+        // copy_data()는 source->data[j]와 그 개수를 data[i]에 저장하는
+        // 함수입니다.
+        // Pre : i < data_count, j < source->data_count
+        // Post : data[i]가 source->data[j]와 같아진다. data_count는 그대로.
+        void copy_data(size_t i, const node *source, size_t j);
+
+        // move_data()는 copy_data()와 같지만 source->data[j]를 move 하는
+        // 함수입니다. source는 다른 bag과 공유하지 않는 노드여야 한다.
+        // Pre : i < data_count, j < source->data_count
+        // Post : data[i]에 source->data[j]가 옮겨진다. source->data[j]는
+        //        moved-from 상태가 된다.
+        void move_data(size_t i, node *source, size_t j);
+
+        // open_slot()은 insert_data()에서 data[i]를 비우기 위해 data[i]부터
+        // 한칸씩 뒤로 미는 함수입니다.
+        void open_slot(size_t i);
+
+        // remove_data()는 data[i]를 삭제하는 함수입니다.
+        // Pre : i < data_count
+        // Post : data[i]를 삭제. data[i+1]에 아이템이 존재한다면 한칸씩
+        //        앞으로 당긴다. data_count는 1 감소.
+        void remove_data(size_t i);
+
+        // remove_range()는 data[first]부터 data[last - 1]까지 삭제하는
+        // 함수입니다.
+        // Pre : first <= last <= data_count
+        // Post : 뒤의 데이터를 (last - first)칸 앞으로 당긴다. data_count는
+        //        (last - first) 감소.
+        void remove_range(size_t first, size_t last);
+    };
+
+    // leaf_node는 데이터만 가지는 리프노드입니다.
+    struct leaf_node : node {
+        leaf_node();
+    };
+
+    // internal_node는 자식 포인터 배열을 추가로 가지는 내부노드입니다.
+    // order-statistic 모드에서는 child[i] 서브트리의 데이터 수를
+    // child_total(i)로 가진다.
+    struct internal_node : node,
+                           bag_node_child_totals<MAXIMUM + 2, ORDER_STATS> {
+        size_t child_count; // 현재 노드의 자식 수
+        node *child[MAXIMUM + 2];
+
+        internal_node();
+
+        // insert_child()는 child[i]에 child를 삽입하는 함수입니다.
+        // Pre : i <= child_count
+        // Post : child[i]에 child를 삽입하고 서브트리의 데이터 수를 total로
+        //        한다. child[i]에 이미 아이템이 존재한다면 한칸씩 뒤로 민다.
+        //        child_count는 1 증가.
+        void insert_child(size_t i, node *child, size_t total);
+
+        // remove_child()는 child[i]를 삭제하는 함수입니다.
+        // Pre : i < child_count
+        // Post : child[i]를 삭제. child[i+1]에 아이템이 존재한다면 한칸씩
+        //        앞으로 당긴다. child_count는 1 감소.
+        void remove_child(size_t i);
+    };
+
+    // 트리의 높이는 최대 (MINIMUM + 1)을 밑으로 하는 log(size()) + 1 이므로,
+    // size_t로 셀수 있는 데이터의 수에 대해 MAX_HEIGHT를 넘지 않는다.
+    static constexpr size_t floor_log2(size_t x) {
+        return x < 2 ? 0 : 1 + floor_log2(x / 2);
+    }
+    static const size_t MAX_HEIGHT =
+        sizeof(size_t) * 8 / floor_log2(MINIMUM + 1) + 1;
+
+  public:
+    // const_iterator는 bag의 데이터를 오름차순으로 순회하는 반복자입니다.
+    // 루트에서 현재 데이터까지의 경로를 스택에 저장하므로 부모 포인터 없이
+    // 다음 데이터로 이동할수 있고, 긴 범위를 순회할때 한 데이터당 평균 O(1)에
+    // 이동합니다. 같은 데이터는 그 개수만큼 반복해서 방문합니다. bag이
+    // 바뀌면(insert, erase 등) 기존의 반복자는 사용할수 없습니다.
+    class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Item value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Item *pointer;
+        typedef const Item &reference;
+
+        // Default Constructor. end()와 같은 반복자를 만든다.
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        // operator++는 다음 데이터로 이동하는 함수입니다.
+        // Pre : *this != end()
+        // Post : 다음 데이터로 이동. 마지막 데이터였다면 end()가 된다.
+        const_iterator &operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+      private:
+        friend class bag;
+
+        // frame은 경로에 있는 노드 하나와 그 노드에서의 위치입니다. 스택의
+        // 맨 위 노드에서 index는 현재 데이터의 위치이고, 그 아래의 노드들에서
+        // index는 내려간 자식의 위치입니다. 자식 child[index]의 순회가 끝나면
+        // 다음 데이터는 data[index]가 됩니다.
+        struct frame {
+            const node *n;
+            size_t index;
+        };
+
+        frame path[MAX_HEIGHT];
+        size_t depth; // 스택에 있는 frame의 수. 0이면 end()
+        size_t rep;   // run-length 모드에서 현재 데이터를 방문한 횟수
+
+        // push()는 경로에 frame을 추가하는 함수입니다.
+        void push(const node *n, size_t index);
+
+        // descend_leftmost()는 n부터 가장 왼쪽 리프노드까지 내려가면서
+        // 경로에 추가하는 함수입니다.
+        void descend_leftmost(const node *n);
+
+        // settle()은 맨 위 frame의 index가 노드의 끝을 넘었을때 다음 데이터가
+        // 있는 조상 노드까지 올라가는 함수입니다.
+        void settle();
+
+        // next_slot()은 현재 데이터의 반복 횟수와 상관없이 다음 자리의
+        // 데이터로 이동하는 함수입니다.
+        void next_slot();
+
+        // multiplicity()는 현재 자리의 데이터 개수를 반환하는 함수입니다.
+        size_t multiplicity() const;
+    };
+    typedef const_iterator iterator;
+
+    // begin() 함수는 가장 작은 데이터를 가리키는 반복자를 반환하는
+    // 함수입니다.
+    // Pre : None.
+    // Post : bag이 비어있다면 end()를 반환.
+    const_iterator begin() const;
+
+    // end() 함수는 마지막 데이터의 다음을 가리키는 반복자를 반환하는
+    // 함수입니다.
+    // Pre : None.
+    // Post : 역참조할수 없는 반복자를 반환.
+    const_iterator end() const;
+
+    // lower_bound() 함수는 target보다 작지 않은 첫 데이터를 찾는 함수입니다.
+    // Pre : None.
+    // Post : target 이상인 첫 데이터의 반복자를 반환. 없으면 end() 반환.
+    const_iterator lower_bound(const Item &target) const;
+
+    template <class Key, class C = Compare,
+              class = typename C::is_transparent>
+    const_iterator lower_bound(const Key &target) const;
+
+    // upper_bound() 함수는 target보다 큰 첫 데이터를 찾는 함수입니다.
+    // Pre : None.
+    // Post : target보다 큰 첫 데이터의 반복자를 반환. 없으면 end() 반환.
+    const_iterator upper_bound(const Item &target) const;
+
+    template <class Key, class C = Compare,
+              class = typename C::is_transparent>
+    const_iterator upper_bound(const Key &target) const;
+
+    // equal_range() 함수는 target과 같은 데이터들의 범위를 찾는 함수입니다.
+    // Pre : None.
+    // Post : (lower_bound(target), upper_bound(target))을 반환.
+    std::pair<const_iterator, const_iterator>
+    equal_range(const Item &target) const;
+
+    template <class Key, class C = Compare,
+              class = typename C::is_transparent>
+    std::pair<const_iterator, const_iterator>
+    equal_range(const Key &target) const;
+
+    // count_range() 함수는 lo 이상 hi 이하인 데이터의 수를 세는 함수입니다.
+    // 범위의 시작까지 한번 내려간 후 범위 안의 데이터 자리를 순회합니다.
+    // order-statistic 모드에서는 범위의 크기와 상관없이 두번만 내려갑니다.
+    // Pre : None.
+    // Post : lo <= x <= hi 인 데이터 x의 수를 반환. hi < lo 이면 0 반환.
+    size_t count_range(const Item &lo, const Item &hi) const;
+
+    template <class Key, class C = Compare,
+              class = typename C::is_transparent>
+    size_t count_range(const Key &lo, const Key &hi) const;
+
+  private:
+
+    // node_pools는 노드를 할당하는 pool들입니다. 노드를 공유하는 bag들은 pool도
+    // 함께 가지며, 서로 다른 스레드에서 노드를 할당하고 반환할수 있으므로
+    // lock으로 보호한다. 빈 bag은 pool이 없을수 있고 첫 노드를 할당할때
+    // 만든다.
+    struct node_pools {
+        std::mutex lock;
+        bag_pool<leaf_node, Alloc> leaf;
+        bag_pool<internal_node, Alloc> internal;
+
+        explicit node_pools(const Alloc &alloc);
+    };
+
+    node *root;        // 최상위 노드. bag이 비어있다면 NULL
+    size_t item_count; // bag에 들어있는 데이터의 수
+    Alloc allocator;
+    Compare comparator; // 데이터의 순서. 서로 작지 않은 두 데이터는 같다
+    std::shared_ptr<node_pools> pools; // 노드가 없다면 NULL일수 있다
+    bag_instrument<INSTRUMENT> instrument;
+
+    // build_sorted()는 빈 bag에 정렬된 데이터로 트리를 한번에 만드는
+    // 함수입니다. 각 층에서 노드의 수를 정하고 데이터를 노드에 고르게 나눈 후,
+    // 노드 사이의 데이터를 모아 다음 층을 같은 방법으로 만든다. mults가
+    // NULL이면 모든 데이터의 개수는 1이다.
+    // Pre : root == NULL, items[0..m)은 오름차순이고 run-length 모드에서는
+    //       같은 데이터가 없다. 0 < fill <= 1
+    // Post : items로 이루어진 B-tree가 root가 된다. items의 데이터는 노드로
+    //        move 되어 moved-from 상태가 된다.
+    void build_sorted(Item *items, const size_t *mults, size_t m, double fill);
+
+    // level_node_count()는 build_sorted()에서 데이터 m개가 있는 층을 몇개의
+    // 노드로 나눌지 정하는 함수입니다. 노드 사이의 데이터 하나씩은 다음 층으로
+    // 올라가므로 노드의 데이터 수는 평균 (m + 1) / 노드 수 - 1 이 된다.
+    // Pre : m > 0
+    // Post : 각 노드가 MINIMUM 이상 MAXIMUM 이하의 데이터를 가지면서 데이터
+    //        수가 target에 가장 가까운 노드 수를 반환. m <= MAXIMUM이면 1.
+    static size_t level_node_count(size_t m, size_t target);
+
+    // rebuild_bulk()는 정렬된 items를 run-length 모드에 맞게 정리한 후
+    // build_sorted()를 호출하는 함수입니다.
+    // Pre : root == NULL, items는 오름차순. 0 < fill <= 1
+    // Post : items의 데이터로 트리가 만들어지고 item_count가 갱신된다. items의
+    //        데이터는 move 되어 moved-from 상태가 된다.
+    void rebuild_bulk(item_buffer &items, double fill);
+
+    // set_operation은 combine()이 같은 데이터의 두 개수를 합치는 방법입니다.
+    enum set_operation {
+        SET_SUM,       // 두 개수의 합. merge()
+        SET_MAX,       // 큰 값. union_with()
+        SET_MIN,       // 작은 값. intersect()
+        SET_DIFFERENCE // 현재 개수 - other의 개수. difference()
+    };
+
+    // combine()은 두 트리를 오름차순으로 함께 순회하면서 같은 데이터의
+    // 개수를 op로 합친 결과를 모은 후 build_sorted()로 트리를 다시 만드는
+    // 함수입니다. other가 현재 bag보다 훨씬 작으면 combine_small()을
+    // 사용합니다. other가 현재 bag 자신이어도 된다.
+    // Pre : None.
+    // Post : 각 데이터의 개수가 op로 합친 값이 된다.
+    void combine(const bag &other, set_operation op);
+
+    // combine_small()은 other의 데이터마다 현재 bag을 검색해서 삽입, 삭제
+    // 하는 함수입니다. intersect()만은 결과를 모아 트리를 다시 만든다.
+    // Pre : other는 현재 bag이 아니다.
+    // Post : 각 데이터의 개수가 op로 합친 값이 된다.
+    void combine_small(const bag &other, set_operation op);
+
+    // combined_count()는 같은 데이터의 두 개수 a, b를 op로 합치는
+    // 함수입니다.
+    // Pre : None.
+    // Post : 합친 개수를 반환.
+    static size_t combined_count(size_t a, size_t b, set_operation op);
+
+    // next_run()은 it부터 같은 데이터의 자리들을 지나가면서 그 개수를 세는
+    // 함수입니다.
+    // Pre : it != end()
+    // Post : it은 다음으로 큰 데이터의 첫 자리로 이동하고, 지나간 데이터의
+    //        개수를 반환.
+    size_t next_run(const_iterator &it) const;
+
+    // sort_items()는 [first, last)를 less의 순서로 정렬하는 함수입니다.
+    // 데이터가 많으면 구간을 나눠 스레드마다 정렬한 후 이웃한 구간끼리 병렬로
+    // merge 합니다.
+    // Pre : None.
+    // Post : [first, last)가 오름차순으로 정렬된다.
+    static void sort_items(Item *first, Item *last, const Compare &less);
+
+    // rank_bound()는 order-statistic 모드에서 target의 lower_bound 또는
+    // upper_bound 앞에 있는 데이터의 수를 구하는 함수입니다.
+    // Pre : ORDER_STATS
+    // Post : upper가 false이면 target보다 작은 데이터의 수를, true이면
+    //        target보다 작거나 같은 데이터의 수를 반환.
+    template <class Key>
+    size_t rank_bound(const Key &target, bool upper) const;
+
+    // subtree_size()는 n을 루트로 하는 서브트리의 데이터 수를 n과 n의
+    // child_total()로 계산하는 함수입니다. order-statistic 모드가 아니면 0을
+    // 반환합니다.
+    // Pre : n != NULL
+    // Post : 서브트리의 데이터 수를 반환.
+    static size_t subtree_size(const node *n);
+
+    // find_bound()는 target의 lower_bound 또는 upper_bound 위치를 찾는
+    // 함수입니다.
+    // Pre : None.
+    // Post : upper가 false이면 lower_bound(target)을, true이면
+    //        upper_bound(target)을 반환.
+    template <class Key>
+    const_iterator find_bound(const Key &target, bool upper) const;
+
+    // count_key()는 count()의 본체입니다. Key는 Item이거나 transparent
+    // 비교자로 Item과 비교할수 있는 타입이다.
+    // Pre : None.
+    // Post : bag에 있는 target의 개수를 반환.
+    template <class Key> size_t count_key(const Key &target) const;
+
+    // count_between()은 count_range()의 본체입니다.
+    // Pre : None.
+    // Post : lo <= x <= hi 인 데이터 x의 수를 반환.
+    template <class Key>
+    size_t count_between(const Key &lo, const Key &hi) const;
+
+    // count()는 n을 루트로 하는 서브트리에서 target의 개수를 세는 함수입니다.
+    // Pre : n != NULL
+    // Post : 서브트리에 있는 target의 개수를 반환.
+    template <class Key> size_t count(const node *n, const Key &target) const;
+
+    // prefix_lookup<Key>는 Key로 찾을때 노드의 prefix key를 사용할수
+    // 있는지를 나타냅니다.
+    template <class Key>
+    using prefix_lookup = std::integral_constant<
+        bool, PREFIX_KEYS &&
+                  std::is_convertible<const Key &, std::string_view>::value>;
+
+    // find_slot()은 노드 n에서 target의 lower_bound(upper이면 upper_bound)
+    // 위치를 찾는 함수입니다. Key가 Item이면 search 커널을, Item과 다른
+    // 타입이면 비교자를 사용하는 bag_scalar_search를 사용합니다. 노드가
+    // prefix key를 가지고 target이 문자열이면 bag_prefix_search를 사용합니다.
+    // Pre : n != NULL
+    // Post : upper가 false이면 data[i] < target 인 i의 개수를, true이면
+    //        !(target < data[i]) 인 i의 개수를 반환.
+    template <class Key>
+    size_t find_slot(const node *n, const Key &target, bool upper) const;
+
+    template <class Key>
+    size_t find_slot(const node *n, const Key &target, bool upper,
+                     std::false_type) const;
+
+    template <class Key>
+    size_t find_slot(const node *n, const Key &target, bool upper,
+                     std::true_type) const;
+
+    // lookup_batch()는 count_batch()와 contains_batch()의 본체입니다.
+    // Result가 bool이면 있는지만, size_t이면 개수를 구한다. 데이터를
+    // 정렬하고 스레드마다 구간을 나눠 lookup_range()를 호출한다.
+    // Pre : keys와 out은 n개의 원소를 가진다.
+    // Post : out[i]가 keys[i]의 결과가 된다.
+    template <class Result>
+    void lookup_batch(const Item *keys, size_t n, Result *out,
+                      const bag_batch_options &options) const;
+
+    // lookup_range()는 검색 순서의 [begin, end) 구간을 BATCH_GROUP개씩
+    // 묶어서 찾는 함수입니다. order가 NULL이 아니면 i번째로 찾을 데이터는
+    // keys[order[i]]이다. 데이터가 있는 노드나 리프노드에 닿은 검색은
+    // 묶음에서 빠지고 나머지 검색만 다음 층으로 내려간다.
+    // Pre : root != NULL
+    // Post : 구간의 데이터의 결과가 out에 쓰여진다.
+    template <class Result>
+    void lookup_range(const Item *keys, const size_t *order, size_t begin,
+                      size_t end, Result *out) const;
+
+    // count_at()은 lookup_range()의 검색이 멈춘 노드 n에서 target의 개수를
+    // 세는 함수입니다. 조상 노드에는 target이 없으므로 target은 모두 n의
+    // 서브트리에 있다.
+    // Pre : first는 n에서 target의 lower_bound 이다.
+    // Post : bag에 있는 target의 개수를 반환.
+    size_t count_at(const node *n, size_t first, const Item &target) const;
+
+    // prefetch_node()는 n의 앞부분(데이터 배열까지)을 캐시로 미리 읽어오도록
+    // 요청하는 함수입니다. 지원하지 않는 컴파일러에서는 아무것도 하지 않는다.
+    static void prefetch_node(const node *n);
+
+    // insert_entry()는 insert()의 본체입니다. Entry가 rvalue이면 리프노드에
+    // 넣을때 entry를 move 한다.
+    // Pre : None.
+    // Post : bag에 entry가 추가된다.
+    template <class Entry> void insert_entry(Entry &&entry);
+
+    // loose_insert()는 n을 루트로 하는 서브트리에 entry를 추가하되, MAXIMUM
+    // 조건을 깨뜨릴 가능성이 있습니다. 즉 삽입 후 특정 노드의 data 수가
+    // MAXIMUM + 1 개가 될수 있습니다. entry는 리프노드에 넣을때만 forward
+    // 한다.
+    // Pre : n != NULL
+    // Post : 서브트리에 entry를 삽입. n의 data의 수가 MAXIMUM + 1 개가 될수
+    //        있음.
+    template <class Entry> void loose_insert(node *n, Entry &&entry);
+
+    // fix_excess()는 loose_insert()후 n->child[i]의 data 수가 MAXIMUM + 1 개가
+    // 될때 이를 처리하는 함수입니다.
+    // Pre : (i < n->child_count) && (n->child[i]->data_count == MAXIMUM + 1)
+    // Post : child[i]의 가운데 데이터를 n에 추가하고 child[i]를 두개의
+    //        child로 분할.
+    void fix_excess(internal_node *n, size_t i);
+
+    // loose_erase()는 n을 루트로 하는 서브트리에서 target을 제거하되, MINIMUM
+    // 조건을 깨뜨릴 가능성이 있습니다. 즉 삭제 후 특정 노드의 data 수가
+    // MINIMUM - 1 개가 될수 있습니다. all이 true이면 run-length 모드에서
+    // target의 개수와 상관없이 자리 하나를 통째로 삭제합니다. present는
+    // 서브트리에 target이 있다는 것을 이미 확인했는지이며, 아니라면 공유하는
+    // 자식으로 내려가기 전에 holds()로 확인해서 target이 없을때 복사하지
+    // 않습니다.
+    // Pre : n은 다른 bag과 공유하지 않는 노드.
+    // Post : 서브트리에서 target을 제거하고 제거한 개수를 반환. target이
+    //        없다면 0을 반환하고 트리는 바뀌지 않는다. n의 data의 수가
+    //        MINIMUM - 1 개가 될수 있음. 루트 노드의 경우 data의 수가 0개가
+    //        될수 있음.
+    size_t loose_erase(node *n, const Item &target, bool all, bool present);
+
+    // holds()는 n을 루트로 하는 서브트리에 target이 있는지 트리를 바꾸지
+    // 않고 확인하는 함수입니다. 공유하는 노드를 삭제를 위해 복사하기 전에
+    // 사용한다.
+    // Pre : n != NULL
+    // Post : target이 있으면 true 반환.
+    bool holds(const node *n, const Item &target) const;
+
+    // fix_root()는 loose_erase()후 최상위 노드의 data가 0개가 되었을때 이를
+    // 처리하는 함수입니다.
+    // Pre : root != NULL
+    // Post : 최상위 노드의 data가 0개라면 유일한 자식을 최상위 노드로
+    //        삼는다. 최상위 노드가 빈 리프노드라면 root는 NULL이 된다.
+    void fix_root();
+
+    // fix_shortage()는 loose_erase()후 n->child[i]의 data 수가 MINIMUM - 1
+    // 개가 될때 이를 처리하는 함수입니다.
+    // Pre : (i < n->child_count) && (n->child[i]->data_count == MINIMUM - 1)
+    // Post : child[i-1]이나 child[i+1]에서 데이터를 가져올수 있으면 child[i]에
+    //        가져온다. 데이터를 가져올수 없다면 n에서 데이터를 하나 빼서
+    //        child[i]와 child[i-1](또는 child[i+1])를 merge한다.
+    void fix_shortage(internal_node *n, size_t i);
+
+    // rotate_right()는 child[i]의 마지막 데이터를 data[i]로 올리고 data[i]를
+    // child[i+1]의 처음으로 내리는 함수입니다. 자식이 있다면 child[i]의
+    // 마지막 자식도 child[i+1]로 옮긴다. rotate_left()는 반대 방향이다.
+    // Pre : i + 1 < n->child_count, 데이터를 주는 자식의 data_count > 0
+    // Post : 두 자식의 데이터 수가 하나씩 바뀌고 순서는 그대로이다.
+    void rotate_right(internal_node *n, size_t i);
+    void rotate_left(internal_node *n, size_t i);
+
+    // piece는 split()과 join()이 자르고 붙이는 B-tree입니다. 최상위 노드
+    // 외의 노드는 MINIMUM 조건을 만족한다. height는 리프노드가 1이고 빈
+    // 트리(root == NULL)는 0이다.
+    struct piece {
+        node *root;
+        size_t height;
+    };
+
+    // split_node()는 n을 루트로 하는 서브트리를 key보다 작은 데이터의
+    // left와 나머지 데이터의 right로 나누는 함수입니다. 검색 경로의 노드만
+    // 나누고, 경로 양쪽의 자식 서브트리는 그대로 left나 right에 붙인다.
+    // count_left이면 left로 간 데이터의 수를, 아니면 right로 간 데이터의
+    // 수를 counted에 더한다.
+    // Pre : n은 다른 bag과 공유하지 않는 노드이고 높이는 height.
+    // Post : n의 데이터가 모두 left와 right로 옮겨진다. n은 재사용되거나
+    //        pool에 반환된다.
+    void split_node(node *n, size_t height, const Item &key, bool count_left,
+                    piece &left, piece &right, size_t &counted);
+
+    // join_pieces()는 left, sep, right를 차례로 이어붙인 트리를 만드는
+    // 함수입니다. 낮은 트리를 높은 트리의 가장자리 경로에서 같은 높이가
+    // 되는 자리에 붙이므로 O(두 높이의 차 + 1) 입니다.
+    // Pre : left의 데이터 <= sep <= right의 데이터
+    // Post : 이어붙인 트리를 반환. sep는 moved-from 상태가 된다.
+    piece join_pieces(piece left, Item &sep, size_t mult, piece right);
+
+    // graft()는 n을 루트로 하는 높이 height의 트리의 오른쪽 끝(at_end가
+    // false이면 왼쪽 끝)에 sep와 shorter를 붙이는 함수입니다. 붙인 자리가
+    // MINIMUM 조건을 만족하지 않으면 balance_children()으로, 경로의 노드가
+    // 넘치면 fix_excess()로 고친다.
+    // Pre : height > shorter.height
+    // Post : 붙인 트리의 n은 MAXIMUM + 1 개의 데이터를 가질수 있다. n은
+    //        공유하지 않는 노드로 바뀐다.
+    void graft(node *&n, size_t height, Item &sep, size_t mult,
+               const piece &shorter, bool at_end);
+
+    // balance_children()은 n->child[i]와 n->child[i+1] 중 MINIMUM 조건을
+    // 만족하지 않는 것이 있을때 두 자식을 merge 하거나, merge 할수 없으면
+    // 한쪽에서 데이터를 옮겨오는 함수입니다.
+    // Pre : i + 1 < n->child_count, 두 자식의 높이가 같다.
+    // Post : 두 자식이 모두 MINIMUM 조건을 만족하거나 하나로 merge 된다.
+    void balance_children(internal_node *n, size_t i);
+
+    // erase_every()는 erase_all()의 본체로, n을 루트로 하는 서브트리에서
+    // target을 모두 제거한 트리를 반환하는 함수입니다. count()처럼 target이
+    // 있을수 있는 child[first]부터 child[last]까지만 내려가며, 그 사이의
+    // 자식은 target만 가지므로 세기만 하고 해제한다. 양 끝의 자식에서 남은
+    // 두 트리는 join_pieces()로 잇고, 낮아지거나 모자라게 된 자식은
+    // place_piece()로 고친다. present는 loose_erase()와 같다. 제거한
+    // 데이터의 수는 removed에 더한다.
+    // Pre : n은 다른 bag과 공유하지 않는 노드이고 높이는 height.
+    // Post : 반환하는 트리의 최상위 노드는 MINIMUM 조건을 만족하지 않을수
+    //        있고 높이가 height보다 낮을수 있다. n은 재사용되거나 pool에
+    //        반환된다.
+    piece erase_every(node *n, size_t height, const Item &target, bool present,
+                      size_t &removed);
+
+    // place_piece()는 n->child[i]의 자리에 p를 놓는 함수입니다. p의 높이가
+    // 다른 자식과 같으면 그대로 놓고, 모자라면 balance_children()으로
+    // 고친다. p가 낮거나 비었다면 n의 데이터 하나와 함께 이웃 자식에
+    // graft()로 붙인다.
+    // Pre : n은 다른 bag과 공유하지 않는 높이 height의 노드이고,
+    //       p.height < height, n->child[i]는 이미 p로 옮겨진 자리다.
+    // Post : 고친 n의 트리를 반환. n의 데이터가 0개가 되면 n 대신 유일한
+    //        자식이 반환된다.
+    piece place_piece(internal_node *n, size_t height, size_t i, piece p);
+
+    // drop_empty_root()는 p의 최상위 노드에 데이터가 없을때 이를 없애는
+    // 함수입니다.
+    // Pre : None.
+    // Post : 빈 리프노드는 빈 트리가 되고, 데이터가 없는 내부노드는 유일한
+    //        자식으로 바뀐다.
+    void drop_empty_root(piece &p);
+
+    // adopt_pools()는 두 bag의 노드가 같은 pool에 있도록 하는 함수입니다.
+    // other의 pool을 다른 bag이 함께 가지지 않으면 other의 노드를 이 bag의
+    // pool로 옮기고, split()으로 떼어낸 bag처럼 other의 pool은 공유하지만 이
+    // bag의 pool은 그렇지 않다면 반대로 이 bag의 노드를 other의 pool로 옮긴
+    // 후 그 pool을 함께 가진다. 두 pool을 모두 다른 bag과 공유하거나
+    // allocator가 다르면 옮길수 없습니다.
+    // Pre : pools와 other.pools는 NULL이 아니다.
+    // Post : 옮겼다면 true 반환. 두 bag의 pools가 같아진다.
+    bool adopt_pools(bag &other);
+
+    // tree_height()는 n을 루트로 하는 서브트리의 높이를 구하는 함수입니다.
+    // Pre : None.
+    // Post : 리프노드는 1, NULL은 0을 반환.
+    static size_t tree_height(const node *n);
+
+    // count_subtree()는 n을 루트로 하는 서브트리의 데이터 수를 세는
+    // 함수입니다. order-statistic 모드에서는 subtree_size()를 사용하고,
+    // 아니면 서브트리의 노드를 모두 방문한다.
+    // Pre : n != NULL
+    // Post : 서브트리의 데이터 수를 반환.
+    static size_t count_subtree(const node *n);
+
+    // remove_biggest()는 n을 루트로 하는 서브트리에서 가장 큰 데이터를
+    // removed_enrty에 저장후 삭제하는 함수입니다.
+    // Pre : n != NULL
+    // Post : 서브트리에서 가장 큰 데이터를 removed_entry에, 그 개수를
+    //        removed_mult에 저장후 삭제한다. 노드를 삭제하면서 n의 data의 수가
+    //        MINIMUM - 1개가 될수 있음.
+    void remove_biggest(node *n, Item &removed_enrty, size_t &removed_mult);
+
+    // stats_rec()은 stats()에서 n을 루트로 하는 서브트리의 노드들을 세는
+    // 함수입니다. shared는 n의 조상 중 공유하는 노드가 있는지이다.
+    // Pre : n != NULL
+    // Post : 서브트리의 노드 수, 데이터 자리 수, 높이가 result에 더해진다.
+    void stats_rec(const node *n, size_t depth, bool shared,
+                   bag_stats &result) const;
+
+    // dump_state는 show_contents()가 출력하는 동안의 상태입니다. 출력은
+    // buffer에 모았다가 DUMP_BUFFER를 넘을때마다 out에 쓴다.
+    struct dump_state {
+        std::ostream &out;
+        const bag_dump_options &options;
+        std::ostringstream buffer;
+        size_t nodes;   // 지금까지 출력한 노드 수
+        size_t next_id; // DOT에서 다음 노드에 붙일 번호
+
+        dump_state(std::ostream &out, const bag_dump_options &options);
+        void flush();
+        void flush_if_full();
+    };
+    static const std::streamoff DUMP_BUFFER = 64 * 1024;
+
+    // can_dump()는 depth의 노드를 출력할수 있는지 확인하는 함수입니다.
+    // Pre : None.
+    // Post : 깊이와 노드 수 제한 안이라면 true를 반환.
+    static bool can_dump(const dump_state &state, size_t depth);
+
+    // omitted_items()는 생략하는 자식 in->child[i]의 데이터 수를 구하는
+    // 함수입니다. order-statistic 모드가 아니면 0을 반환합니다.
+    // Pre : i < in->child_count
+    // Post : 서브트리의 데이터 수를 반환.
+    static size_t omitted_items(const internal_node *in, size_t i);
+
+    // dump_text()는 n을 루트로 하는 서브트리를 가로로 누운 텍스트로 출력하는
+    // 함수입니다. 오른쪽 서브트리가 위에 오고 깊이마다 4칸씩 들여씁니다.
+    // Pre : n != NULL
+    // Post : 서브트리가 state.buffer에 출력된다.
+    void dump_text(const node *n, size_t depth, dump_state &state) const;
+
+    // dump_text_entry()는 dump_text()에서 n->data[i] 한줄을 출력하는
+    // 함수입니다.
+    // Pre : i < n->data_count
+    // Post : 데이터와 run-length 개수가 한줄로 출력된다.
+    static void dump_text_entry(const node *n, size_t i, size_t depth,
+                                dump_state &state);
+
+    // dump_dot()은 n을 루트로 하는 서브트리를 DOT의 record 노드와 edge로
+    // 출력하는 함수입니다.
+    // Pre : n != NULL
+    // Post : 서브트리가 출력되고 n에 붙인 번호를 반환.
+    size_t dump_dot(const node *n, size_t depth, dump_state &state) const;
+
+    // dump_json()은 n을 루트로 하는 서브트리를 JSON 객체로 출력하는
+    // 함수입니다.
+    // Pre : n != NULL
+    // Post : 서브트리가 JSON 객체 하나로 출력된다.
+    void dump_json(const node *n, size_t depth, dump_state &state) const;
+
+    // dump_summary()는 위쪽 층부터 층별 노드 수, 데이터 수, 채워진 비율을
+    // 출력하는 함수입니다.
+    // Pre : None.
+    // Post : 트리의 크기와 높이, 출력할 범위의 층이 표로 출력된다.
+    void dump_summary(dump_state &state) const;
+
+    // write_escaped()는 item을 DOT의 label이나 JSON 문자열 안에 쓸수 있도록
+    // 특수 문자를 escape 해서 출력하는 함수입니다.
+    // Pre : None.
+    // Post : escape 된 item이 out에 출력된다.
+    static void write_escaped(std::ostream &out, const Item &item, bool json);
+
+    // write_json_item()은 item을 JSON 값으로 출력하는 함수입니다. 숫자
+    // 타입은 숫자로, 그 외의 타입은 문자열로 출력합니다. 실수는 다시 읽었을때
+    // 같은 값이 되도록 max_digits10 자리까지 출력하고, JSON에 없는 nan과
+    // inf는 null로 출력합니다.
+    // Pre : None.
+    // Post : item이 JSON 값으로 out에 출력된다.
+    static void write_json_item(std::ostream &out, const Item &item,
+                                std::true_type);
+    static void write_json_item(std::ostream &out, const Item &item,
+                                std::false_type);
+
+    // merge_child()는 fix_shortage()에서 두 child를 merge할때 사용하는
+    // 함수입니다.
+    // Pre : i < n->child_count - 1
+    // Post : child[i]와 child[i+1]을 merge. 이때 n의 데이터 하나를 가져와
+    //        child[i]와 child[i+1] 사이에 둔다. child[i+1]은 pool에 반환된다.
+    void merge_child(internal_node *n, size_t i);
+
+    // new_leaf(), new_internal()은 pool에서 빈 노드를 할당하는 함수입니다.
+    // Pre : None.
+    // Post : 데이터와 자식이 없는 새 노드를 반환.
+    leaf_node *new_leaf();
+    internal_node *new_internal();
+
+    // node_pool()은 노드를 할당할 pool을 반환하는 함수입니다.
+    // Pre : None.
+    // Post : pools가 NULL이면 새로 만든 후 반환.
+    node_pools &node_pool();
+
+    // delete_node()는 노드 하나를 pool에 반환하는 함수입니다. 자식 노드들은
+    // 해제하지 않습니다.
+    // Pre : n은 이 bag의 pool에서 할당받은 노드.
+    // Post : n의 소멸자를 호출하고 메모리를 pool에 반환.
+    void delete_node(node *n);
+
+    // release()는 노드 n에 대한 참조 하나를 없애는 함수입니다.
+    // Pre : n != NULL
+    // Post : n의 참조 수가 1 줄어든다. 0이 되면 자식들도 release()한 후 n을
+    //        pool에 반환.
+    void release(node *n);
+
+    // clone_node()는 노드 n 하나만 복사하는 함수입니다. 자식은 복사하지 않고
+    // 함께 가리키므로 자식들의 참조 수가 1씩 늘어난다.
+    // Pre : n != NULL
+    // Post : 참조 수가 1인 복사본을 반환.
+    node *clone_node(const node *n);
+
+    // writable_child()는 n->child[i]를 바꾸기 전에 호출하는 함수입니다.
+    // Pre : n은 다른 bag과 공유하지 않는 노드, i < n->child_count
+    // Post : child[i]가 공유하는 노드였다면 복사본으로 바꾼다. 바꿀수 있는
+    //        child[i]를 반환.
+    node *writable_child(internal_node *n, size_t i);
+
+    // make_root_writable()은 최상위 노드를 바꾸기 전에 호출하는 함수입니다.
+    // Pre : root != NULL
+    // Post : root가 공유하는 노드였다면 복사본으로 바꾼다.
+    void make_root_writable();
+
+    // make_writable()은 부모가 없는 노드 n을 바꾸기 전에 호출하는
+    // 함수입니다. split()과 join()이 떼어낸 서브트리에 사용한다.
+    // Pre : n != NULL
+    // Post : n이 공유하는 노드였다면 복사본으로 바꾼다.
+    void make_writable(node *&n);
+
+    // destroy_tree()는 n을 루트로 하는 서브트리의 모든 Item의 소멸자를
+    // 호출하는 함수입니다. 메모리는 pool의 release()로 한번에 해제합니다.
+    // Pre : None.
+    // Post : 서브트리의 모든 노드의 소멸자가 호출된다.
+    void destroy_tree(node *n);
+};
+
+// bag_copy() 함수는 bag인 source를 복사해서 반환하는 함수입니다.
+// Pre : None.
+// Post : source와 노드를 공유하는 복사본을 만들어 포인터를 반환.
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare> *
+bag_copy(bag<Item, MINIMUM, Alloc, OPTIONS, Compare> *source);
+
+// run_length_bag은 run-length 모드의 bag입니다.
+template <class Item, size_t MINIMUM = bag_default_minimum<Item>::value>
+using run_length_bag =
+    bag<Item, MINIMUM, std::allocator<Item>, BAG_RUN_LENGTH>;
+
+// order_statistic_bag은 rank(), select(), quantile()을 지원하는 bag입니다.
+template <class Item, size_t MINIMUM = bag_default_minimum<Item>::value>
+using order_statistic_bag =
+    bag<Item, MINIMUM, std::allocator<Item>, BAG_ORDER_STATS>;
+
+// ordered_bag은 데이터를 Compare의 순서로 저장하는 bag입니다.
+template <class Item, class Compare,
+          size_t MINIMUM = bag_default_minimum<Item>::value>
+using ordered_bag =
+    bag<Item, MINIMUM, std::allocator<Item>, BAG_DEFAULT, Compare>;
+
+// string_bag은 std::string을 위한 bag입니다. 노드가 공통 앞부분을 뺀 prefix
+// key를 가지고, std::string_view나 const char *로 찾을수 있다.
+template <size_t MINIMUM = bag_default_minimum<std::string>::value>
+using string_bag = bag<std::string, MINIMUM, std::allocator<std::string>,
+                       BAG_PREFIX_COMPRESSION, std::less<>>;
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::leaf_node::leaf_node() {
+    this->refs.store(1, std::memory_order_relaxed);
+    this->leaf = true;
+    this->data_count = 0;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::internal_node::internal_node() {
+    this->refs.store(1, std::memory_order_relaxed);
+    this->leaf = false;
+    this->data_count = 0;
+    child_count = 0;
+    for (size_t i = 0; i < MAXIMUM + 2; i++)
+        child[i] = NULL;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node_pools::node_pools(
+    const Alloc &alloc)
+    : leaf(alloc), internal(alloc) {}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::bag()
+    : root(NULL), item_count(0) {}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::bag(const Alloc &alloc)
+    : root(NULL), item_count(0), allocator(alloc) {}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::bag(const Compare &compare,
+                                                 const Alloc &alloc)
+    : root(NULL), item_count(0), allocator(alloc), comparator(compare) {}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::bag(const bag &source)
+    : root(source.root), item_count(source.item_count),
+      allocator(source.allocator), comparator(source.comparator),
+      pools(source.pools) {
+    // 노드를 복사하지 않고 최상위 노드의 참조 수만 늘린다
+    if (root != NULL)
+        root->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::bag(bag &&source) noexcept
+    : root(source.root), item_count(source.item_count),
+      allocator(source.allocator), comparator(source.comparator),
+      pools(std::move(source.pools)) {
+    // 노드와 pool을 모두 가져왔으므로 source는 pool이 없는 빈 bag이 된다
+    source.root = NULL;
+    source.item_count = 0;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class InputIterator>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::bag(InputIterator first,
+                                                 InputIterator last,
+                                                 const Alloc &alloc)
+    : root(NULL), item_count(0), allocator(alloc) {
+    assign(first, last);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::~bag() {
+    clear();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare> &
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::operator=(const bag &source) {
+    if (this != &source) {
+        clear();
+        root = source.root;
+        item_count = source.item_count;
+        // 공유하는 노드는 source의 allocator로 만든 source의 pool에 있으므로
+        // 복사 생성자처럼 셋을 함께 가져온다
+        allocator = source.allocator;
+        comparator = source.comparator;
+        pools = source.pools;
+        if (root != NULL)
+            root->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare> &
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::operator=(bag &&source) {
+    if (this != &source) {
+        clear();
+        root = source.root;
+        item_count = source.item_count;
+        allocator = source.allocator;
+        comparator = source.comparator;
+        pools = std::move(source.pools);
+        source.root = NULL;
+        source.item_count = 0;
+    }
+    return *this;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::snapshot() const {
+    return bag(*this);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count(
+    const Item &target) const {
+    return count_key(target);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key, class C, class>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count(
+    const Key &target) const {
+    return count_key(target);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_key(
+    const Key &target) const {
+    instrument.add(&bag_counters::lookup_calls);
+    if (root == NULL)
+        return 0;
+    if (ORDER_STATS && !RUN_LENGTH)
+        // 같은 데이터가 여러 서브트리에 흩어져 있어도 두번만 내려간다
+        return rank_bound(target, true) - rank_bound(target, false);
+    return count(root, target);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count(
+    const node *n, const Key &target) const {
+    instrument.add(&bag_counters::lookup_visits);
+    if (RUN_LENGTH) {
+        // run-length 모드에서는 같은 데이터가 트리에 한번만 있으므로
+        // 리프노드까지 한번만 내려가면 된다
+        size_t index = find_slot(n, target, false);
+        if (index < n->data_count && !comparator(target, n->data[index]))
+            return n->multiplicity(index);
+        if (n->leaf)
+            return 0;
+        return count(static_cast<const internal_node *>(n)->child[index],
+                     target);
+    }
+
+    // target과 같은 데이터는 data[first]부터 data[last - 1]까지 모여있다.
+    // 같은 데이터가 없다면 first == last 이고 data[first]가 target이 있을만한
+    // 위치가 된다.
+    size_t first = find_slot(n, target, false);
+    size_t last = find_slot(n, target, true);
+    size_t count = last - first;
+
+    if (!n->leaf) {
+        /* target이 같은 데이터들의 왼쪽, 오른쪽 자식에 또 존재할수 있기 때문에
+         * child[first]부터 child[last]까지 모두 찾는다. target이 노드에 없다면
+         * child[first] 하나만 찾게 된다. */
+        const internal_node *in = static_cast<const internal_node *>(n);
+        for (size_t i = first; i <= last; i++)
+            count += this->count(in->child[i], target);
+    }
+
+    return count;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_batch(
+    const Item *keys, size_t n, size_t *counts,
+    const bag_batch_options &options) const {
+    lookup_batch(keys, n, counts, options);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::contains_batch(
+    const Item *keys, size_t n, bool *found,
+    const bag_batch_options &options) const {
+    lookup_batch(keys, n, found, options);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Result>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::lookup_batch(
+    const Item *keys, size_t n, Result *out,
+    const bag_batch_options &options) const {
+    instrument.add(&bag_counters::lookup_calls, n);
+    if (root == NULL) {
+        std::fill(out, out + n, Result());
+        return;
+    }
+
+    // 정렬한 순서로 찾으면 이웃한 검색이 같은 노드를 지나므로 캐시를 재사용
+    // 한다. 데이터 대신 위치를 정렬해서 결과를 원래 자리에 쓴다.
+    std::vector<size_t> order;
+    if (options.sort_keys) {
+        order.resize(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = i;
+        const Compare &less = comparator;
+        std::sort(order.begin(), order.end(),
+                  [keys, &less](size_t a, size_t b) {
+                      return less(keys[a], keys[b]);
+                  });
+    }
+    const size_t *sequence = options.sort_keys ? order.data() : NULL;
+
+    size_t threads = options.threads;
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads > n / PARALLEL_BATCH_MIN)
+        threads = n / PARALLEL_BATCH_MIN;
+    if (INSTRUMENT || threads < 2) { // 횟수는 한 스레드에서만 센다
+        lookup_range(keys, sequence, 0, n, out);
+        return;
+    }
+
+    // 첫 구간은 호출한 스레드가 직접 찾는다. 정렬했다면 각 스레드가 이웃한
+    // 데이터들을 맡게 된다.
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++)
+        workers.push_back(std::thread(
+            [this, keys, sequence, out](size_t begin, size_t end) {
+                this->lookup_range(keys, sequence, begin, end, out);
+            },
+            n * t / threads, n * (t + 1) / threads));
+    lookup_range(keys, sequence, 0, n / threads, out);
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Result>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::lookup_range(
+    const Item *keys, const size_t *order, size_t begin, size_t end,
+    Result *out) const {
+    assert(root != NULL); // Precondition
+
+    const bool counting = !std::is_same<Result, bool>::value;
+    const node *path[BATCH_GROUP]; // 각 검색이 다음에 볼 노드
+    size_t slot[BATCH_GROUP];      // 각 검색의 keys와 out에서의 위치
+
+    for (size_t base = begin; base < end; base += BATCH_GROUP) {
+        size_t active = end - base;
+        if (active > BATCH_GROUP)
+            active = BATCH_GROUP;
+        for (size_t j = 0; j < active; j++) {
+            slot[j] = (order != NULL) ? order[base + j] : base + j;
+            path[j] = root;
+        }
+
+        // 묶음의 검색들을 한층씩 번갈아 내려간다. 한 검색의 다음 노드를
+        // prefetch 한 후 다른 검색들의 노드를 비교하므로, 그 노드를 다시
+        // 볼때는 이미 캐시에 올라와 있다.
+        while (active > 0) {
+            for (size_t j = 0; j < active;) {
+                const node *n = path[j];
+                const Item &target = keys[slot[j]];
+                instrument.add(&bag_counters::lookup_visits);
+
+                size_t first = find_slot(n, target, false);
+                bool found = first < n->data_count &&
+                             !comparator(target, n->data[first]);
+                if (!found && !n->leaf) {
+                    path[j] =
+                        static_cast<const internal_node *>(n)->child[first];
+                    prefetch_node(path[j]);
+                    j++;
+                    continue;
+                }
+
+                // 끝난 검색은 묶음의 마지막 검색과 자리를 바꿔서 뺀다
+                if (counting)
+                    out[slot[j]] = found ? count_at(n, first, target) : 0;
+                else
+                    out[slot[j]] = found;
+                --active;
+                path[j] = path[active];
+                slot[j] = slot[active];
+            }
+        }
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_at(
+    const node *n, size_t first, const Item &target) const {
+    if (RUN_LENGTH) // 같은 데이터는 한 자리에만 있다
+        return n->multiplicity(first);
+    if (n->leaf)
+        return find_slot(n, target, true) - first;
+    if (ORDER_STATS)
+        // 같은 데이터가 여러 서브트리에 걸쳐 있으면 순위의 차로 구한다
+        return rank_bound(target, true) - rank_bound(target, false);
+    return count(n, target);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::prefetch_node(const node *n) {
+#if defined(__GNUC__)
+    size_t lines = (sizeof(node) + 63) / 64;
+    if (lines > PREFETCH_LINES)
+        lines = PREFETCH_LINES;
+    const char *bytes = reinterpret_cast<const char *>(n);
+    for (size_t i = 0; i < lines; i++)
+        __builtin_prefetch(bytes + 64 * i);
+#else
+    (void)n;
+#endif
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::insert(const Item &entry) {
+    insert_entry(entry);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::insert(Item &&entry) {
+    insert_entry(std::move(entry));
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class... Args>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::emplace(Args &&...args) {
+    // 자리를 찾으려면 비교할 데이터가 있어야 하므로 먼저 만든 후 move 한다
+    insert_entry(Item(std::forward<Args>(args)...));
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Entry>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::insert_entry(Entry &&entry) {
+    instrument.add(&bag_counters::insert_calls);
+    if (root == NULL)
+        root = new_leaf(); // 빈 bag이라면 리프노드 하나로 시작한다
+    else
+        make_root_writable();
+
+    loose_insert(root, std::forward<Entry>(entry));
+    ++item_count;
+
+    if (root->data_count == MAXIMUM + 1) {
+        // 최상위 노드가 MAXIMUM 조건을 만족시키지 못하므로 데이터를 부모로
+        // 올려야하는데, 최상위 노드는 부모노드가 존재하지 않는다. 따라서 새
+        // 내부노드를 만들어 기존 최상위 노드를 자식으로 삼는다. 포인터만
+        // 바꾸므로 O(1)에 처리된다.
+        internal_node *new_root = new_internal();
+        // 기존 루트를 첫번째 자식으로 삼는다.
+        new_root->insert_child(0, root, subtree_size(root));
+        root = new_root;
+        fix_excess(new_root, 0); // child[0], 즉 기존 루트가 MAXIMUM 조건을
+                                 // 만족시키지 못하므로 fix_excess(0)를 호출한다.
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Entry>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::loose_insert(node *n,
+                                                               Entry &&entry) {
+    instrument.add(&bag_counters::insert_visits);
+    // entry를 넣을 만한 data나 child의 index를 찾는다
+    size_t index = find_slot(n, entry, false);
+
+    if (RUN_LENGTH && index < n->data_count &&
+        !comparator(entry, n->data[index])) {
+        // run-length 모드에서 같은 데이터가 이미 있다면 개수만 늘린다
+        n->set_multiplicity(index, n->multiplicity(index) + 1);
+        return;
+    }
+
+    if (!n->leaf) { // 리프노드에 도달할때까지 재귀적으로 호출
+        internal_node *in = static_cast<internal_node *>(n);
+        loose_insert(writable_child(in, index), std::forward<Entry>(entry));
+        in->set_child_total(index, in->child_total(index) + 1);
+
+        /* 재귀 호출 후 child가 MAXIMUM 조건을 만족시키지 못하면 fix */
+        if (in->child[index]->data_count == MAXIMUM + 1)
+            fix_excess(in, index);
+    } else { // 리프노드라면 entry를 삽입
+        n->insert_data(index, std::forward<Entry>(entry));
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::fix_excess(internal_node *n,
+                                                             size_t i) {
+    assert(i < n->child_count);                     // Precondition
+    assert(n->child[i]->data_count == MAXIMUM + 1); // Precondition
+    instrument.add(&bag_counters::splits);
+
+    node *full_child = n->child[i];
+    node *splited_child; // 분리시킬 자식 서브트리. 분리할 자식과 같은 종류의
+                         // 노드로 만든다.
+    if (full_child->leaf)
+        splited_child = new_leaf();
+    else
+        splited_child = new_internal();
+
+    /* 현재 노드에 child[i]의 중간 데이터 삽입 */
+    n->insert_data(i, std::move(full_child->data[MINIMUM]),
+                   full_child->multiplicity(MINIMUM));
+
+    /* 자식의 데이터 반을 분리 */
+    splited_child->data_count = MINIMUM;
+    for (size_t j = 0; j < MINIMUM; j++) {
+        splited_child->move_data(j, full_child, MINIMUM + 1 + j);
+    }
+    full_child->data_count = MINIMUM;
+
+    // 나눠진 두 자식은 공통 앞부분이 더 길어질수 있으므로 prefix key를 다시
+    // 구한다
+    full_child->reset_prefix_keys(full_child->data, MINIMUM);
+    splited_child->reset_prefix_keys(splited_child->data, MINIMUM);
+
+    /* 자식이 자식을 가진다면 자식의 자식을 분리 */
+    if (!full_child->leaf) {
+        internal_node *left = static_cast<internal_node *>(full_child);
+        internal_node *right = static_cast<internal_node *>(splited_child);
+        for (size_t j = 0; j <= MINIMUM; j++) {
+            /* shallow copy(어떤 노드도 삭제되지 않기 때문에 deep copy를 할
+             * 필요가 없다) 후 분리된 자식의 자리는 모두 NULL로 할당 */
+            right->child[j] = left->child[MINIMUM + 1 + j];
+            right->set_child_total(j, left->child_total(MINIMUM + 1 + j));
+            left->child[MINIMUM + 1 + j] = NULL;
+        }
+        right->child_count = MINIMUM + 1;
+        left->child_count = MINIMUM + 1;
+    }
+
+    // 분리된 자식을 child[i+1]에 삽입하고 두 자식의 데이터 수를 다시 센다
+    n->insert_child(i + 1, splited_child, subtree_size(splited_child));
+    n->set_child_total(i, subtree_size(full_child));
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::erase_one(
+    const Item &target) {
+    instrument.add(&bag_counters::erase_calls);
+    if (root == NULL)
+        return false;
+
+    // 공유하는 최상위 노드는 target이 있을때만 복사한다. target이 없다면
+    // loose_erase()가 트리를 바꾸지 않고 0을 반환한다.
+    bool present = false;
+    if (root->refs.load(std::memory_order_acquire) > 1) {
+        if (!holds(root, target))
+            return false;
+        present = true;
+    }
+    make_root_writable();
+    if (loose_erase(root, target, false, present) == 0)
+        return false;
+
+    --item_count;
+    fix_root();
+    return true;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::erase_all(
+    const Item &target) {
+    instrument.add(&bag_counters::erase_calls);
+    if (root == NULL)
+        return 0;
+
+    // erase_one()처럼 공유하는 최상위 노드는 target이 있을때만 복사한다
+    bool present = false;
+    if (root->refs.load(std::memory_order_acquire) > 1) {
+        if (!holds(root, target))
+            return 0;
+        present = true;
+    }
+    make_root_writable();
+    size_t removed = 0;
+    if (RUN_LENGTH) {
+        // run-length 모드에서는 target의 자리 하나만 삭제하면 된다
+        removed = loose_erase(root, target, true, present);
+        fix_root();
+    } else {
+        // 최상위 노드는 erase_every()가 돌려준 트리로 한번만 바꾼다
+        root = erase_every(root, tree_height(root), target, present, removed)
+                   .root;
+    }
+    item_count -= removed;
+    return removed;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::fix_root() {
+    assert(root != NULL); // Precondition
+
+    if (root->data_count == 0) {
+        // loose_erase() 후 최상위 노드의 data가 0개인 경우 유일한 자식을
+        // 최상위 노드로 삼고 비어버린 기존 최상위 노드만 삭제한다. 손자
+        // 노드들은 복사하지 않으므로 O(1)에 처리된다. 최상위 노드가
+        // 리프노드라면 bag이 빈 것이다.
+        node *old_root = root;
+        if (old_root->leaf) {
+            root = NULL;
+        } else {
+            internal_node *in = static_cast<internal_node *>(old_root);
+            root = in->child[0];
+            in->remove_child(0);
+        }
+        // old_root는 make_root_writable()로 이 bag만 가지는 빈 노드이므로
+        // 자신만 삭제된다
+        delete_node(old_root);
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::loose_erase(
+    node *n, const Item &target, bool all, bool present) {
+    instrument.add(&bag_counters::erase_visits);
+    // target이 있을 만한 data나 child의 index를 찾는다
+    size_t index = find_slot(n, target, false);
+
+    internal_node *in = n->leaf ? NULL : static_cast<internal_node *>(n);
+    size_t removed = 0;
+
+    // lower_bound 위치의 데이터가 target보다 크지 않다면 target과 같다
+    if ((index < n->data_count) && !comparator(target, n->data[index])) {
+        removed = all ? n->multiplicity(index) : 1;
+
+        if (RUN_LENGTH && n->multiplicity(index) > removed) {
+            // run-length 모드에서 target이 여러개 있다면 개수만 줄인다
+            n->set_multiplicity(index, n->multiplicity(index) - removed);
+        } else if (in == NULL) {
+            // 리프노드에서 target을 발견했다면 그냥 삭제한다.
+            n->remove_data(index);
+        } else {
+            // 리프노드가 아닌 노드에서 target을 찾았다면 왼쪽 서브트리에서 가장
+            // 큰 값을 target 자리에 놓고 해당 값을 삭제한다.
+            size_t mult;
+            remove_biggest(writable_child(in, index), in->data[index], mult);
+            in->set_multiplicity(index, mult);
+            in->update_prefix_key(in->data, in->data_count, index);
+            in->set_child_total(index, in->child_total(index) - mult);
+
+            if (in->child[index]->data_count == MINIMUM - 1)
+                // fix_shortage()는 자식을 fix하는 것이므로 child[i]에 대해서는
+                // 여기서 fix해 주어야 한다.
+                fix_shortage(in, index);
+        }
+    } else if (in != NULL) {
+        // target을 발견하지 못했으면 리프노드에 도달할때까지 재귀적으로
+        // 호출한다. 공유하는 자식은 target이 있을때만 복사한다.
+        const node *next = in->child[index];
+        if (!present && next->refs.load(std::memory_order_acquire) > 1) {
+            if (!holds(next, target))
+                return 0;
+            present = true;
+        }
+        removed = loose_erase(writable_child(in, index), target, all, present);
+        in->set_child_total(index, in->child_total(index) - removed);
+
+        if (in->child[index]->data_count == MINIMUM - 1)
+            // 재귀적으로 호출후 child[index]가 MINUMUM 조건을 만족하지 않을시
+            // fix한다.
+            fix_shortage(in, index);
+    }
+
+    return removed;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::holds(
+    const node *n, const Item &target) const {
+    // target이 있다면 lower_bound 위치의 데이터이거나 그 왼쪽 자식에 있다
+    while (true) {
+        instrument.add(&bag_counters::erase_visits);
+        size_t index = find_slot(n, target, false);
+        if (index < n->data_count && !comparator(target, n->data[index]))
+            return true;
+        if (n->leaf)
+            return false;
+        n = static_cast<const internal_node *>(n)->child[index];
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::fix_shortage(internal_node *n,
+                                                               size_t i) {
+    assert(i < n->child_count);                     // Precondition
+    assert(n->child[i]->data_count == MINIMUM - 1); // Precondition
+    instrument.add(&bag_counters::shortages);
+
+    node **child = n->child;
+
+    if (i > 0 && child[i - 1]->data_count > MINIMUM) {
+        /* 왼쪽 서브트리에게 데이터를 하나 받아온다 */
+        instrument.add(&bag_counters::borrow_left);
+        rotate_right(n, i - 1);
+    } else if ((i < n->child_count - 1) &&
+               (child[i + 1]->data_count > MINIMUM)) {
+        /* 오른쪽 서브트리에게 데이터를 하나 받아온다 */
+        instrument.add(&bag_counters::borrow_right);
+        rotate_left(n, i);
+    } else if (i > 0) {
+        // 왼쪽 child와 merge 한다
+        merge_child(n, i - 1);
+    } else {
+        // 오른쪽 child와 merge 한다
+        merge_child(n, i);
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::rotate_right(internal_node *n,
+                                                               size_t i) {
+    assert(i + 1 < n->child_count); // Precondition
+
+    node *left = writable_child(n, i);
+    node *right = writable_child(n, i + 1);
+    size_t last_index = left->data_count - 1;
+
+    // data[i]를 child[i+1]의 첫번째에 삽입한다
+    right->insert_data(0, std::move(n->data[i]), n->multiplicity(i));
+
+    // data[i]에 child[i]의 마지막 데이터를 가져와서 저장한다
+    n->move_data(i, left, last_index);
+    left->remove_data(last_index);
+
+    // 자식이 존재한다면 child[i]의 마지막 자식을 child[i+1]의 첫번째 자식으로
+    // 삼는다
+    if (!left->leaf) {
+        internal_node *left_in = static_cast<internal_node *>(left);
+        internal_node *right_in = static_cast<internal_node *>(right);
+        last_index = left_in->child_count - 1;
+        right_in->insert_child(0, left_in->child[last_index],
+                               left_in->child_total(last_index));
+        left_in->remove_child(last_index);
+    }
+    n->set_child_total(i, subtree_size(left));
+    n->set_child_total(i + 1, subtree_size(right));
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::rotate_left(internal_node *n,
+                                                              size_t i) {
+    assert(i + 1 < n->child_count); // Precondition
+
+    node *left = writable_child(n, i);
+    node *right = writable_child(n, i + 1);
+
+    // data[i]를 child[i]의 마지막에 삽입한다
+    left->insert_data(left->data_count, std::move(n->data[i]),
+                      n->multiplicity(i));
+
+    // child[i+1]의 첫번째 데이터를 data[i]에 저장한다
+    n->move_data(i, right, 0);
+    right->remove_data(0);
+
+    // 자식이 존재한다면 child[i+1]의 첫번째 자식을 child[i]의 마지막 자식으로
+    // 삼는다
+    if (!left->leaf) {
+        internal_node *left_in = static_cast<internal_node *>(left);
+        internal_node *right_in = static_cast<internal_node *>(right);
+        left_in->insert_child(left_in->child_count, right_in->child[0],
+                              right_in->child_total(0));
+        right_in->remove_child(0);
+    }
+    n->set_child_total(i, subtree_size(left));
+    n->set_child_total(i + 1, subtree_size(right));
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::remove_biggest(
+    node *n, Item &removed_enrty, size_t &removed_mult) {
+    instrument.add(&bag_counters::erase_visits);
+    if (n->leaf) {
+        // 가장 오른쪽 리프노드의 가장 오른쪽 데이터가 가장 큰 값이므로 해당
+        // 데이터를 removed_enrty에 저장후 삭제한다
+        --n->data_count;
+        removed_enrty = std::move(n->data[n->data_count]);
+        removed_mult = n->multiplicity(n->data_count);
+    } else {
+        internal_node *in = static_cast<internal_node *>(n);
+
+        // 가장 오른쪽 자식노드에 대해 재귀적으로 호출한다
+        size_t last = in->child_count - 1;
+        remove_biggest(writable_child(in, last), removed_enrty, removed_mult);
+        in->set_child_total(last, in->child_total(last) - removed_mult);
+
+        // 가장 오른쪽 자식이 MINIMUM 조건을 불만족하면 fix한다
+        if (in->child[last]->data_count == MINIMUM - 1)
+            fix_shortage(in, last);
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::show_contents() const {
+    show_contents(std::cout, bag_dump_options());
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::show_contents(
+    std::ostream &out, const bag_dump_options &options) const {
+    dump_state state(out, options);
+
+    switch (options.format) {
+    case BAG_DUMP_TEXT:
+        if (root == NULL)
+            break;
+        if (can_dump(state, 0))
+            dump_text(root, 0, state);
+        else
+            state.buffer << "... (" << item_count << " items)\n";
+        break;
+    case BAG_DUMP_DOT:
+        state.buffer << "digraph bag {\n    node [shape=record];\n";
+        if (root != NULL && can_dump(state, 0))
+            dump_dot(root, 0, state);
+        else if (root != NULL)
+            state.buffer << "    n0 [shape=plaintext, label=\"... ("
+                         << item_count << " items)\"];\n";
+        state.buffer << "}\n";
+        break;
+    case BAG_DUMP_JSON:
+        state.buffer << "{\"size\": " << item_count << ", \"root\": ";
+        if (root == NULL)
+            state.buffer << "null";
+        else if (can_dump(state, 0))
+            dump_json(root, 0, state);
+        else
+            state.buffer << "{\"omitted\": true, \"items\": " << item_count
+                         << "}";
+        state.buffer << "}\n";
+        break;
+    case BAG_DUMP_SUMMARY:
+        dump_summary(state);
+        break;
+    }
+
+    // 버퍼에 남은 출력을 쓰고 한번만 flush 한다
+    state.flush();
+    out.flush();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_state::dump_state(
+    std::ostream &out, const bag_dump_options &options)
+    : out(out), options(options), nodes(0), next_id(0) {}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_state::flush() {
+    out << buffer.str();
+    buffer.str("");
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_state::flush_if_full() {
+    if (buffer.tellp() > DUMP_BUFFER)
+        flush();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::can_dump(
+    const dump_state &state, size_t depth) {
+    return depth < state.options.max_depth &&
+           state.nodes < state.options.max_nodes;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::omitted_items(
+    const internal_node *in, size_t i) {
+    return in->child_total(i);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_text(
+    const node *n, size_t depth, dump_state &state) const {
+    state.nodes++;
+    if (n->leaf) {
+        // 리프노드는 자식이 없으므로 데이터를 한번에 모두 출력한다
+        for (size_t i = n->data_count; i > 0; i--)
+            dump_text_entry(n, i - 1, depth, state);
+    } else {
+        const internal_node *in = static_cast<const internal_node *>(n);
+
+        // 오른쪽 자식을 먼저 출력후 그 왼쪽의 데이터를 출력한다. 제한을 넘는
+        // 자식은 생략 표시만 한다.
+        for (size_t i = in->child_count; i > 0; i--) {
+            if (can_dump(state, depth + 1)) {
+                dump_text(in->child[i - 1], depth + 1, state);
+            } else {
+                state.buffer << std::setw(4 * (depth + 1)) << "" << "...";
+                if (ORDER_STATS)
+                    state.buffer << " (" << omitted_items(in, i - 1)
+                                 << " items)";
+                state.buffer << '\n';
+            }
+            if (i > 1)
+                dump_text_entry(n, i - 2, depth, state);
+        }
+    }
+    state.flush_if_full();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_text_entry(
+    const node *n, size_t i, size_t depth, dump_state &state) {
+    state.buffer << std::setw(4 * depth) << "" << n->data[i];
+    if (n->multiplicity(i) > 1) // run-length 모드의 개수
+        state.buffer << " (x" << n->multiplicity(i) << ")";
+    state.buffer << '\n';
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_dot(
+    const node *n, size_t depth, dump_state &state) const {
+    size_t id = state.next_id++;
+    const internal_node *in =
+        n->leaf ? NULL : static_cast<const internal_node *>(n);
+    state.nodes++;
+
+    // 내부노드는 데이터 사이에 자식으로 가는 port(<c0>, <c1>, ...)를 둔다
+    state.buffer << "    n" << id << " [label=\"";
+    for (size_t i = 0; i < n->data_count; i++) {
+        if (in != NULL)
+            state.buffer << "<c" << i << "> |";
+        else if (i > 0)
+            state.buffer << '|';
+        write_escaped(state.buffer, n->data[i], false);
+        if (n->multiplicity(i) > 1)
+            state.buffer << " x" << n->multiplicity(i);
+        if (in != NULL)
+            state.buffer << '|';
+    }
+    if (in != NULL)
+        state.buffer << "<c" << n->data_count << "> ";
+    state.buffer << "\"];\n";
+
+    if (in != NULL) {
+        for (size_t i = 0; i < in->child_count; i++) {
+            size_t child_id;
+            if (can_dump(state, depth + 1)) {
+                child_id = dump_dot(in->child[i], depth + 1, state);
+            } else {
+                child_id = state.next_id++;
+                state.buffer << "    n" << child_id
+                             << " [shape=plaintext, label=\"...";
+                if (ORDER_STATS)
+                    state.buffer << " (" << omitted_items(in, i) << " items)";
+                state.buffer << "\"];\n";
+            }
+            state.buffer << "    n" << id << ":c" << i << " -> n" << child_id
+                         << ";\n";
+        }
+    }
+    state.flush_if_full();
+    return id;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_json(
+    const node *n, size_t depth, dump_state &state) const {
+    state.nodes++;
+    state.buffer << "{\"keys\": [";
+    for (size_t i = 0; i < n->data_count; i++) {
+        if (i > 0)
+            state.buffer << ", ";
+        write_json_item(state.buffer, n->data[i],
+                        std::is_arithmetic<Item>());
+    }
+    state.buffer << ']';
+
+    if (RUN_LENGTH) { // 각 데이터의 개수
+        state.buffer << ", \"counts\": [";
+        for (size_t i = 0; i < n->data_count; i++)
+            state.buffer << (i > 0 ? ", " : "") << n->multiplicity(i);
+        state.buffer << ']';
+    }
+
+    if (!n->leaf) {
+        const internal_node *in = static_cast<const internal_node *>(n);
+        state.buffer << ", \"children\": [";
+        for (size_t i = 0; i < in->child_count; i++) {
+            if (i > 0)
+                state.buffer << ", ";
+            if (can_dump(state, depth + 1)) {
+                dump_json(in->child[i], depth + 1, state);
+            } else {
+                state.buffer << "{\"omitted\": true";
+                if (ORDER_STATS)
+                    state.buffer << ", \"items\": " << omitted_items(in, i);
+                state.buffer << '}';
+            }
+        }
+        state.buffer << ']';
+    }
+    state.buffer << '}';
+    state.flush_if_full();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::dump_summary(
+    dump_state &state) const {
+    // 모든 리프노드는 같은 깊이에 있으므로 가장 왼쪽 경로로 높이를 구한다
+    size_t height = 0;
+    for (const node *n = root; n != NULL;
+         n = n->leaf ? NULL : static_cast<const internal_node *>(n)->child[0])
+        height++;
+
+    state.buffer << "size " << item_count << ", height " << height
+                 << ", max keys per node " << MAXIMUM << '\n';
+    state.buffer << "level      nodes       keys    fill\n";
+
+    // 한층씩 내려가면서 출력할 층의 노드만 모은다
+    std::vector<const node *> level, next;
+    if (root != NULL)
+        level.push_back(root);
+    size_t depth = 0;
+    for (; !level.empty() && depth < state.options.max_depth &&
+           level.size() <= state.options.max_nodes - state.nodes;
+         depth++) {
+        size_t keys = 0;
+        next.clear();
+        for (size_t j = 0; j < level.size(); j++) {
+            const node *n = level[j];
+            keys += n->data_count;
+            if (!n->leaf && depth + 1 < state.options.max_depth) {
+                const internal_node *in = static_cast<const internal_node *>(n);
+                next.insert(next.end(), in->child, in->child + in->child_count);
+            }
+        }
+        state.nodes += level.size();
+
+        state.buffer << std::setw(5) << depth << std::setw(11) << level.size()
+                     << std::setw(11) << keys << std::setw(8) << std::fixed
+                     << std::setprecision(3)
+                     << double(keys) / (level.size() * MAXIMUM) << '\n';
+        level.swap(next);
+    }
+    if (depth < height)
+        state.buffer << "... (" << height - depth << " more levels)\n";
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::write_escaped(
+    std::ostream &out, const Item &item, bool json) {
+    std::ostringstream text;
+    text << item;
+    const std::string s = text.str();
+
+    // DOT의 record label에서는 "\{}|<>가, JSON 문자열에서는 "\가 특별한
+    // 문자이다. 제어 문자는 JSON에서 \u로 쓰고 DOT에서는 공백으로 바꾼다.
+    const char *specials = json ? "\"\\" : "\"\\{}|<>";
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c < 0x20) {
+            if (json)
+                out << "\\u00" << "0123456789abcdef"[c >> 4]
+                    << "0123456789abcdef"[c & 15];
+            else
+                out << ' ';
+            continue;
+        }
+        if (std::strchr(specials, c) != NULL)
+            out << '\\';
+        out << s[i];
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::write_json_item(
+    std::ostream &out, const Item &item, std::true_type) {
+    if (std::is_floating_point<Item>::value) {
+        if (!std::isfinite(item)) {
+            out << "null";
+            return;
+        }
+        std::streamsize precision =
+            out.precision(std::numeric_limits<Item>::max_digits10);
+        out << item;
+        out.precision(precision);
+        return;
+    }
+    out << +item; // char 타입도 숫자로 출력한다
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::write_json_item(
+    std::ostream &out, const Item &item, std::false_type) {
+    out << '"';
+    write_escaped(out, item, true);
+    out << '"';
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::insert_data(
+    size_t i, const Item &entry, size_t mult) {
+    assert(i <= data_count); // Precondition
+
+    open_slot(i);
+    data[i] = entry;
+    this->set_multiplicity(i, mult);
+    data_count++;
+    this->update_prefix_key(data, data_count, i);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::insert_data(
+    size_t i, Item &&entry, size_t mult) {
+    assert(i <= data_count); // Precondition
+
+    open_slot(i);
+    data[i] = std::move(entry);
+    this->set_multiplicity(i, mult);
+    data_count++;
+    this->update_prefix_key(data, data_count, i);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::open_slot(size_t i) {
+    // 데이터를 한칸씩 뒤로 민다. 복사하지 않고 move 한다.
+    for (size_t j = data_count; j > i; j--) {
+        data[j] = std::move(data[j - 1]);
+        this->set_multiplicity(j, this->multiplicity(j - 1));
+        this->set_prefix_key(j, this->prefix_key(j - 1));
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::copy_data(
+    size_t i, const node *source, size_t j) {
+    assert(i < data_count && j < source->data_count); // Precondition
+
+    data[i] = source->data[j];
+    this->set_multiplicity(i, source->multiplicity(j));
+    this->update_prefix_key(data, data_count, i);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::move_data(size_t i,
+                                                                  node *source,
+                                                                  size_t j) {
+    assert(i < data_count && j < source->data_count); // Precondition
+
+    data[i] = std::move(source->data[j]);
+    this->set_multiplicity(i, source->multiplicity(j));
+    this->update_prefix_key(data, data_count, i);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::internal_node::insert_child(
+    size_t i, node *child, size_t total) {
+    assert(i <= child_count); // Precondition
+
+    // 자식을 한칸씩 뒤로 민다
+    for (size_t j = child_count; j > i; j--) {
+        this->child[j] = this->child[j - 1];
+        this->set_child_total(j, this->child_total(j - 1));
+    }
+
+    this->child[i] = child;
+    this->set_child_total(i, total);
+    child_count++;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::remove_data(size_t i) {
+    assert(i < data_count); // Precondition
+    data_count--;
+
+    // 데이터를 한칸씩 앞으로 당긴다
+    for (; i < data_count; i++) {
+        data[i] = std::move(data[i + 1]);
+        this->set_multiplicity(i, this->multiplicity(i + 1));
+        this->set_prefix_key(i, this->prefix_key(i + 1));
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node::remove_range(
+    size_t first, size_t last) {
+    assert(first <= last && last <= data_count); // Precondition
+
+    // 남는 데이터를 한번에 앞으로 당긴다. 자기 자신으로 move 하면 비워지는
+    // 타입이 있으므로 지울 데이터가 없으면 그대로 둔다.
+    if (first == last)
+        return;
+    size_t gap = last - first;
+    for (size_t i = last; i < data_count; i++) {
+        data[i - gap] = std::move(data[i]);
+        this->set_multiplicity(i - gap, this->multiplicity(i));
+        this->set_prefix_key(i - gap, this->prefix_key(i));
+    }
+    data_count -= gap;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::internal_node::remove_child(
+    size_t i) {
+    assert(i < child_count); // Precondition
+    child_count--;
+
+    // 자식을 한칸씩 앞으로 당긴다
+    for (; i < child_count; i++) {
+        child[i] = child[i + 1];
+        this->set_child_total(i, this->child_total(i + 1));
+    }
+    child[child_count] = NULL;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::merge_child(internal_node *n,
+                                                              size_t i) {
+    assert(i < n->child_count - 1); // Precondition
+    instrument.add(&bag_counters::merges);
+    node *left = writable_child(n, i);
+    node *right = n->child[i + 1]; // 다른 bag과 공유할수 있다
+    size_t right_index;
+
+    // merge된 child[i]는 두 자식과 data[i]를 모두 가진다
+    n->set_child_total(i, n->child_total(i) + n->multiplicity(i) +
+                              n->child_total(i + 1));
+
+    // data[i]을 child[i]의 마지막에 삽입한다
+    left->insert_data(left->data_count, std::move(n->data[i]),
+                      n->multiplicity(i));
+    n->remove_data(i);
+
+    // child[i+1]의 모든 데이터를 child[i]의 끝으로 이동시킨다. 두 자식의 데이터
+    // 수는 MINIMUM에 따라 달라지므로 child[i+1]의 data_count만큼 옮긴다.
+    // child[i+1]을 이 bag만 가지고 있다면 곧 삭제되므로 데이터를 move 한다.
+    bool exclusive = right->refs.load(std::memory_order_acquire) == 1;
+    for (right_index = 0; right_index < right->data_count; right_index++) {
+        if (exclusive)
+            left->insert_data(left->data_count,
+                              std::move(right->data[right_index]),
+                              right->multiplicity(right_index));
+        else
+            left->insert_data(left->data_count, right->data[right_index],
+                              right->multiplicity(right_index));
+    }
+
+    // child[i]에 자식이 존재하면 child[i+1]의 모든 자식을 child[i]의 끝으로
+    // 이동시킨다. 포인터만 옮기므로 손자 노드들을 복사할 필요가 없다. 손자
+    // 노드들은 child[i]가 새로 가리키므로 참조 수를 늘린다.
+    if (!left->leaf) {
+        internal_node *left_in = static_cast<internal_node *>(left);
+        internal_node *right_in = static_cast<internal_node *>(right);
+        for (right_index = 0; right_index < right_in->child_count;
+             right_index++) {
+            node *grandchild = right_in->child[right_index];
+            grandchild->refs.fetch_add(1, std::memory_order_relaxed);
+            left_in->insert_child(left_in->child_count, grandchild,
+                                  right_in->child_total(right_index));
+        }
+    }
+
+    // child[i+1]을 떼어낸다. 공유하지 않던 노드라면 손자 노드들의 참조 수를
+    // 되돌리면서 삭제된다.
+    n->remove_child(i + 1);
+    release(right);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::clear() {
+    if (pools.use_count() == 1) {
+        // pool을 공유하는 bag이 없다면 노드도 모두 이 bag의 것이다. 다른
+        // 스레드의 bag이 방금 노드를 반환하고 pool을 놓았을수 있으므로 그
+        // 반환이 끝난 후에 slab을 해제한다.
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Item의 소멸자가 하는 일이 없다면 노드를 하나씩 방문할 필요 없이
+        // slab을 한번에 해제한다
+        if (!std::is_trivially_destructible<Item>::value)
+            destroy_tree(root);
+        pools->leaf.release();
+        pools->internal.release();
+    } else {
+        // 다른 bag과 공유하는 노드가 있을수 있으므로 참조를 하나씩 없애고,
+        // 이후의 노드는 새 pool에서 할당한다
+        if (root != NULL)
+            release(root);
+        pools.reset();
+    }
+    root = NULL;
+    item_count = 0;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::save(const char *path) const {
+    // 다른 순서로 저장하면 writer가 순서가 틀린 데이터를 받게 되고, 파일을
+    // 여는 쪽도 operator<로 찾으므로 컴파일할때 막는다
+    static_assert(std::is_same<Compare, std::less<Item> >::value ||
+                      std::is_same<Compare, std::less<> >::value,
+                  "save() needs Compare to be std::less");
+    bag_file_writer<Item> writer;
+    if (!writer.open(path))
+        return false;
+
+    // 데이터 자리를 오름차순으로 넘기면 writer가 같은 데이터를 모은다
+    for (const_iterator it = begin(); it.depth != 0; it.next_slot())
+        writer.add(*it, it.multiplicity());
+    return writer.finish();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+Alloc bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::get_allocator() const {
+    return allocator;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+Compare bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::key_comp() const {
+    return comparator;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag_stats bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::stats() const {
+    bag_stats result = bag_stats();
+    result.size = item_count;
+    if (root != NULL)
+        stats_rec(root, 1, false, result);
+
+    size_t nodes = result.leaf_nodes + result.internal_nodes;
+    if (nodes > 0)
+        result.fill_factor = double(result.slots) / (nodes * MAXIMUM);
+    result.node_bytes = result.leaf_nodes * sizeof(leaf_node) +
+                        result.internal_nodes * sizeof(internal_node);
+
+    if (pools) {
+        std::lock_guard<std::mutex> guard(pools->lock);
+        result.pool_bytes = pools->leaf.capacity() * sizeof(leaf_node) +
+                            pools->internal.capacity() * sizeof(internal_node);
+    }
+    return result;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::stats_rec(
+    const node *n, size_t depth, bool shared, bag_stats &result) const {
+    // 공유하는 노드 아래의 노드들은 모두 함께 공유된다
+    shared = shared || n->refs.load(std::memory_order_relaxed) > 1;
+    if (shared)
+        result.shared_nodes++;
+    result.slots += n->data_count;
+
+    if (n->leaf) {
+        result.leaf_nodes++;
+        if (depth > result.height) // 모든 리프노드는 같은 깊이에 있다
+            result.height = depth;
+    } else {
+        const internal_node *in = static_cast<const internal_node *>(n);
+        result.internal_nodes++;
+        for (size_t i = 0; i < in->child_count; i++)
+            stats_rec(in->child[i], depth + 1, shared, result);
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag_counters bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::counters() const {
+    static_assert(INSTRUMENT, "counters() needs BAG_INSTRUMENT");
+    return instrument.get();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::reset_counters() {
+    static_assert(INSTRUMENT, "reset_counters() needs BAG_INSTRUMENT");
+    instrument.reset();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::leaf_node *
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::new_leaf() {
+    instrument.add(&bag_counters::node_allocs);
+    node_pools &p = node_pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    return new (p.leaf.allocate()) leaf_node();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::internal_node *
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::new_internal() {
+    instrument.add(&bag_counters::node_allocs);
+    node_pools &p = node_pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    return new (p.internal.allocate()) internal_node();
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node_pools &
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node_pool() {
+    if (!pools)
+        pools = std::allocate_shared<node_pools>(allocator, allocator);
+    return *pools;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::delete_node(node *n) {
+    std::lock_guard<std::mutex> guard(pools->lock);
+    if (n->leaf) {
+        leaf_node *leaf = static_cast<leaf_node *>(n);
+        leaf->~leaf_node();
+        pools->leaf.deallocate(leaf);
+    } else {
+        internal_node *in = static_cast<internal_node *>(n);
+        in->~internal_node();
+        pools->internal.deallocate(in);
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::release(node *n) {
+    // 마지막 참조였다면 다른 bag이 이 노드를 읽은 것이 모두 끝난 후에 삭제한다
+    if (n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    if (!n->leaf) {
+        internal_node *in = static_cast<internal_node *>(n);
+        for (size_t i = 0; i < in->child_count; i++)
+            release(in->child[i]);
+    }
+    delete_node(n);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node *
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::clone_node(const node *n) {
+    instrument.add(&bag_counters::node_copies);
+    node *copy_node; // 복사해서 반환할 노드
+    if (n->leaf) {
+        copy_node = new_leaf();
+    } else {
+        const internal_node *in = static_cast<const internal_node *>(n);
+        internal_node *copy_in = new_internal();
+
+        for (size_t i = 0; i < in->child_count; i++) {
+            // 자식은 복사하지 않고 함께 가리킨다
+            in->child[i]->refs.fetch_add(1, std::memory_order_relaxed);
+            copy_in->child[i] = in->child[i];
+            copy_in->set_child_total(i, in->child_total(i));
+        }
+        copy_in->child_count = in->child_count;
+        copy_node = copy_in;
+    }
+
+    copy_node->data_count = n->data_count;
+    for (size_t i = 0; i < n->data_count; i++) { // 데이터를 복사한다
+        copy_node->copy_data(i, n, i);
+    }
+    copy_node->reset_prefix_keys(copy_node->data, copy_node->data_count);
+
+    return copy_node;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::node *
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::writable_child(internal_node *n,
+                                                            size_t i) {
+    assert(i < n->child_count); // Precondition
+
+    node *c = n->child[i];
+    if (c->refs.load(std::memory_order_acquire) > 1) {
+        // 다른 bag과 공유하는 자식이므로 복사본으로 바꾸고 공유하던 노드에
+        // 대한 참조를 놓는다
+        node *copy_node = clone_node(c);
+        release(c);
+        n->child[i] = c = copy_node;
+    }
+    return c;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::make_root_writable() {
+    assert(root != NULL); // Precondition
+
+    make_writable(root);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::make_writable(node *&n) {
+    assert(n != NULL); // Precondition
+
+    if (n->refs.load(std::memory_order_acquire) > 1) {
+        node *copy_node = clone_node(n);
+        release(n);
+        n = copy_node;
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::destroy_tree(node *n) {
+    if (n == NULL)
+        return;
+
+    if (n->leaf) {
+        static_cast<leaf_node *>(n)->~leaf_node();
+    } else {
+        // 자식들의 소멸자를 먼저 호출한 후 자신의 소멸자를 호출한다
+        internal_node *in = static_cast<internal_node *>(n);
+        for (size_t i = 0; i < in->child_count; i++)
+            destroy_tree(in->child[i]);
+        in->~internal_node();
+    }
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::size() const {
+    return item_count;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::empty() const {
+    return item_count == 0;
+}
 
-/* bag을 B-tree로 구현한 template class 입니다. bag이기 때문에 같은 데이터를
- * 중복해서 저장할수 있습니다. */
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class InputIterator>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::assign(InputIterator first,
+                                                         InputIterator last,
+                                                         double fill) {
+    assert(0 < fill && fill <= 1); // Precondition
 
-template <class Item> class bag {
-  public:
-    // Default Constructor
-    bag();
+    item_buffer items(first, last, allocator);
+    if (!std::is_sorted(items.begin(), items.end(), comparator))
+        sort_items(items.data(), items.data() + items.size(), comparator);
 
-    // Copy Constructor
-    bag(const bag &source);
+    clear();
+    rebuild_bulk(items, fill);
+}
 
-    // Destructor
-    ~bag();
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class InputIterator>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::insert_bulk(
+    InputIterator first, InputIterator last, double fill) {
+    assert(0 < fill && fill <= 1); // Precondition
 
-    // count() 함수는 현재 bag에 target이 몇개 존재하는지 반환하는 함수입니다.
-    // Pre : None.
-    // Post : bag에 있는 target의 개수를 반환. 없을 시 0 반환.
-    size_t count(const Item &target) const;
+    item_buffer batch(first, last, allocator);
+    if (!std::is_sorted(batch.begin(), batch.end(), comparator))
+        sort_items(batch.data(), batch.data() + batch.size(), comparator);
 
-    // insert() 함수는 현재 bag에 entry를 삽입하는 함수입니다.
-    // Pre : None.
-    // Post : bag에 enrty가 추가된다.
-    void insert(const Item &entry);
+    if (batch.size() * BULK_REBUILD_RATIO < item_count) {
+        // 넣을 데이터가 적으면 하나씩 삽입한다. 정렬된 순서로 넣으므로 이웃한
+        // 삽입이 같은 경로를 지나 캐시를 재사용한다.
+        for (size_t i = 0; i < batch.size(); i++)
+            insert(std::move(batch[i]));
+        return;
+    }
 
-    // erase_one 함수는 현재 bag에서 target 하나를 제거하는 함수입니다.
-    // Pre : None.
-    // Post : bag에 taget이 존재하면 삭제후 true 반환.
-    //        target이 존재하지 않으면 false 반환.
-    bool erase_one(const Item &target);
+    // 기존 데이터를 오름차순으로 꺼내면서 batch와 merge한 후 트리를 다시
+    // 만든다
+    item_buffer merged(allocator);
+    merged.reserve(item_count + batch.size());
+    size_t i = 0;
+    for (const_iterator it = begin(); it != end(); ++it) {
+        while (i < batch.size() && comparator(batch[i], *it))
+            merged.push_back(std::move(batch[i++]));
+        merged.push_back(*it);
+    }
+    merged.insert(merged.end(), std::make_move_iterator(batch.begin() + i),
+                  std::make_move_iterator(batch.end()));
 
-    // show_contents() 함수는 bag을 구현하고 있는 B-tree의 현재 상태를 가로로
-    // 출력하는 함수입니다.
-    // Pre : None.
-    // Post : 화면에 B-tree가 가로로 출력된다.
-    void show_contents();
+    clear();
+    rebuild_bulk(merged, fill);
+}
 
-    // clear() 함수는 현재 bag을 빈 bag으로 만드는 함수입니다.
-    // Pre : None.
-    // Post : bag에 동적 할당된 모든 자원을 free 시킨 후 bag을 비운다.
-    void clear();
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::rebuild_bulk(
+    item_buffer &items, double fill) {
+    assert(root == NULL); // Precondition
 
-    // bag_copy() 함수는 bag인 source를 복사해서 반환하는 함수입니다.
-    // Pre : None.
-    // Post : source를 deep copy 후 복사된 bag의 포인터를 반환.
-    template <class Item_> friend bag<Item_> *bag_copy(bag<Item_> *source);
+    if (!RUN_LENGTH) {
+        build_sorted(items.data(), NULL, items.size(), fill);
+    } else {
+        // run-length 모드에서는 같은 데이터를 하나의 자리로 모은다
+        item_buffer runs(allocator);
+        std::vector<size_t> mults;
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!runs.empty() && !comparator(runs.back(), items[i])) {
+                ++mults.back();
+            } else {
+                runs.push_back(std::move(items[i]));
+                mults.push_back(1);
+            }
+        }
+        build_sorted(runs.data(), mults.data(), runs.size(), fill);
+    }
+    item_count = items.size();
+}
 
-  private:
-    static const size_t MINIMUM = 1;
-    static const size_t MAXIMUM = 2 * MINIMUM;
-    size_t data_count; // 현재 노드에 저장하고 있는 데이터의 수
-    Item data[MAXIMUM + 1];
-    size_t child_count; // 현재 노드의 자식 수
-    bag *child[MAXIMUM + 2];
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::merge(bag &&other) {
+    if (&other == this) {
+        combine(other, SET_SUM);
+        return;
+    }
 
-    // loose_insert()는 현재 bag에 entry를 추가하되, MAXIMUM 조건을 깨뜨릴
-    // 가능성이 있습니다. 즉 삽입 후 특정 노드의 data 수가 MAXIMUM + 1 개가 될수
-    // 있습니다.
-    // Pre : None.
-    // Post : 현재 bag에 entry를 삽입. data의 수가 MAXIMUM + 1 개가 될수 있음.
-    void loose_insert(const Item &entry);
+    // 현재 bag이 훨씬 작으면 other의 트리를 가져오고 현재 데이터를 삽입한다
+    if (item_count * BULK_REBUILD_RATIO < other.item_count) {
+        bag smaller(std::move(*this));
+        *this = std::move(other);
+        combine(smaller, SET_SUM);
+        return;
+    }
+    combine(other, SET_SUM);
+    other.clear();
+}
 
-    // fix_excess()는 loose_insert()후 child[i]의 data 수가 MAXIMUM + 1 개가
-    // 될때 이를 처리하는 함수입니다.
-    // Pre : (i < child_count) && (child[i]->data_count == MAXIMUM + 1)
-    // Post : child[i]의 가운데 데이터를 현재노드에 추가하고 child[i]를 두개의
-    //        child로 분할.
-    void fix_excess(size_t i);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::union_with(const bag &other) {
+    combine(other, SET_MAX);
+}
 
-    // loose_erase()는 현재 bag에서 target을 제거하되, MINIMUM 조건을 깨뜨릴
-    // 가능성이 있습니다. 즉 삽입 후 특정 노드의 data 수가 MINIMUM - 1 개가 될수
-    // 있습니다.
-    // Pre : None.
-    // Post : 현재 bag에 target을 제거. data의 수가 MINIMUM - 1 개가 될수 있음.
-    //        루트 노드의 경우 data의 수가 0개가 될수 있음.
-    void loose_erase(const Item &target);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::intersect(const bag &other) {
+    combine(other, SET_MIN);
+}
 
-    // fix_shortage()는 loose_erase()후 child[i]의 data 수가 MINIMUM - 1 개가
-    // 될때 이를 처리하는 함수입니다.
-    // Pre : (i < child_count) && (child[i]->data_count == MINIMUM - 1)
-    // Post : child[i-1]이나 child[i+1]에서 데이터를 가져올수 있으면 child[i]에
-    //        가져온다. 데이터를 가져올수 없다면 현재 노드에서 데이터를 하나
-    //        빼서 child[i]와 child[i-1](또는 child[i+1])를 merge한다.
-    void fix_shortage(size_t i);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::difference(const bag &other) {
+    combine(other, SET_DIFFERENCE);
+}
 
-    // remove_biggest()는 현재 bag에서 가장 큰 데이터를 removed_enrty에 저장후
-    // 삭제하는 함수입니다.
-    // Pre : None.
-    // Post : 현재 노드를 루트노드로 하는 bag에서 가장 큰 데이터를
-    //        removed_entry에 저장후 삭제한다. 노드를 삭제하면서 data의 수가
-    //        MINIMUM - 1개가 될수 있음.
-    void remove_biggest(Item &removed_enrty);
-
-    // show_contents_rec()은 show_contents()에서 재귀적으로 호출하는 함수입니다.
-    // 현재 B-tree를 화면에 가로로 출력합니다.
-    // Pre : None.
-    // Post : 현재 B-tree를 화면에 가로로 출력.
-    void show_contents_rec(size_t depth);
-
-    // insert_data()는 data[i]에 enrty를 삽입하는 함수입니다.
-    // Pre : i <= data_count
-    // Post : data[i]에 enrty를 삽입. data[i]에 이미 아이템이 존재한다면 한칸씩
-    //        뒤로 민다. data_count는 1 증가.
-    void insert_data(size_t i, const Item &entry);
-
-    // insert_child()는 child[i]에 child를 삽입하는 함수입니다.
-    // Pre : i <= child_count
-    // Post : child[i]에 child를 삽입. child[i]에 이미 아이템이 존재한다면
-    // 한칸씩 뒤로 민다. child_count는 1 증가.
-    void insert_child(size_t i, bag *child);
-
-    // remove_data()는 data[i]를 삭제하는 함수입니다.
-    // Pre : i < data_count
-    // Post : data[i]를 삭제. data[i+1]에 아이템이 존재한다면 한칸씩 앞으로
-    //        당긴다. data_count는 1 감소.
-    void remove_data(size_t i);
-
-    // remove_child()는 child[i]를 삭제하는 함수입니다.
-    // Pre : i < child_count
-    // Post : child[i]를 삭제. child[i+1]에 아이템이 존재한다면 한칸씩 앞으로
-    //        당긴다. child_count는 1 감소.
-    void remove_child(size_t i);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::split(const Item &key) {
+    bag right(comparator, allocator);
+    if (root == NULL)
+        return right;
 
-    // merge_child()는 fix_shortage()에서 두 child를 merge할때 사용하는
-    // 함수입니다.
-    // Pre : i < child_count - 1
-    // Post : child[i]와 child[i+1]을 merge. 이때 현재 노드의 데이터 하나를
-    //        가져와 child[i]와 child[i+1] 사이에 둔다.
-    void merge_child(size_t i);
-};
+    // 떼어낸 노드는 그대로 같은 pool에 있다
+    right.pools = pools;
+    make_root_writable();
 
-template <class Item> bag<Item>::bag() {
-    data_count = 0;
-    child_count = 0;
-    for (size_t i = 0; i < MAXIMUM + 2; i++)
-        child[i] = NULL;
+    // 데이터 수는 더 작아 보이는 쪽만 센다
+    bool count_left = 2 * find_slot(root, key, false) <= root->data_count;
+    piece left_piece, right_piece;
+    size_t counted = 0;
+    split_node(root, tree_height(root), key, count_left, left_piece,
+               right_piece, counted);
+
+    size_t left_count = count_left ? counted : item_count - counted;
+    root = left_piece.root;
+    right.root = right_piece.root;
+    right.item_count = item_count - left_count;
+    item_count = left_count;
+    return right;
 }
 
-template <class Item> bag<Item>::bag(const bag &source) {
-    size_t i;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::join(bag &&right) {
+    assert(&right != this); // Precondition
 
-    data_count = source.data_count;
-    for (i = 0; i < data_count; i++) {
-        data[i] = source.data[i];
+    if (right.root == NULL) {
+        right.clear();
+        return;
     }
-
-    child_count = source.child_count;
-    for (i = 0; i < child_count; i++) {
-        // 자식들을 모두 deep_copy
-        child[i] = bag_copy(source.child[i]);
+    if (root == NULL) {
+        *this = std::move(right);
+        return;
+    }
+    if (!adopt_pools(right)) {
+        // 두 pool을 모두 다른 bag과 공유하면 노드를 옮길수 없다
+        combine(right, SET_SUM);
+        right.clear();
+        return;
     }
+
+    piece right_piece = {right.root, tree_height(right.root)};
+    size_t total = item_count + right.item_count;
+    right.root = NULL;
+    right.item_count = 0;
+    right.pools.reset();
+
+    // 현재 트리의 가장 큰 데이터를 떼어 두 트리 사이의 데이터로 쓴다
+    Item sep;
+    size_t mult;
+    make_root_writable();
+    remove_biggest(root, sep, mult);
+    fix_root();
+
+    piece left_piece = {root, tree_height(root)};
+    root = join_pieces(left_piece, sep, mult, right_piece).root;
+    item_count = total;
 }
 
-template <class Item> bag<Item>::~bag() { clear(); }
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::split_node(
+    node *n, size_t height, const Item &key, bool count_left, piece &left,
+    piece &right, size_t &counted) {
+    size_t count = n->data_count;
+    size_t index = find_slot(n, key, false);
+
+    // data[0..index)는 left로, data[index..count)는 right로 간다
+    for (size_t i = 0; i < count; i++)
+        if ((i < index) == count_left)
+            counted += n->multiplicity(i);
 
-template <class Item> size_t bag<Item>::count(const Item &target) const {
-    int count = 0;
-    int index = 0;
+    if (n->leaf) {
+        leaf_node *upper = new_leaf();
+        for (size_t i = index; i < count; i++)
+            upper->insert_data(upper->data_count, std::move(n->data[i]),
+                               n->multiplicity(i));
+        upper->reset_prefix_keys(upper->data, upper->data_count);
+        n->data_count = index;
+        n->reset_prefix_keys(n->data, index);
 
-    while (data[index] < target && index < data_count) {
-        ++index; // target이 있을만한 data나 child의 index를 찾는다
+        // 빈 리프노드는 빈 트리가 된다
+        left.root = n;
+        left.height = 1;
+        right.root = upper;
+        right.height = 1;
+        if (index == 0) {
+            delete_node(n);
+            left.root = NULL;
+            left.height = 0;
+        }
+        if (index == count) {
+            delete_node(upper);
+            right.root = NULL;
+            right.height = 0;
+        }
+        return;
     }
 
-    if (index < data_count && data[index] == target) {
-        /* target이 같은 노드나 왼쪽, 오른쪽 자식에 또 존재할수 있기 때문에 모두
-         * 찾는다 */
-        while (data[index] == target && index < data_count) {
-            ++count;
+    internal_node *in = static_cast<internal_node *>(n);
+    for (size_t i = 0; i < in->child_count; i++)
+        if (i != index && (i < index) == count_left)
+            counted += count_subtree(in->child[i]);
 
-            // 자식이 있는경우 target의 왼쪽 자식에서 찾는다
-            if (child_count != 0)
-                count += child[index]->count(target);
+    // child[index]는 key가 지나가는 자식이므로 재귀적으로 나눈다
+    piece lower_middle, upper_middle;
+    split_node(writable_child(in, index), height - 1, key, count_left,
+               lower_middle, upper_middle, counted);
 
-            ++index;
-        }
+    // data[index]보다 오른쪽의 데이터와 자식은 새 노드로 옮긴다. data[index]는
+    // 그 노드와 upper_middle 사이에 둔다.
+    piece upper = {NULL, 0};
+    Item upper_sep;
+    size_t upper_mult = 0;
+    if (index < count) {
+        upper_sep = std::move(in->data[index]);
+        upper_mult = in->multiplicity(index);
 
-        if (child_count != 0)
-            count += child[index]->count(target); // 마지막 오른쪽 자식도 확인
-    } else if (child_count != 0) {
-        // target이 해당 노드에 없는데 자식이 존재하므로 자식에 있는지 찾는다
-        return child[index]->count(target);
+        internal_node *upper_in = new_internal();
+        for (size_t i = index + 1; i < count; i++)
+            upper_in->insert_data(upper_in->data_count,
+                                  std::move(in->data[i]),
+                                  in->multiplicity(i));
+        for (size_t i = index + 1; i <= count; i++) {
+            upper_in->insert_child(upper_in->child_count, in->child[i],
+                                   in->child_total(i));
+            in->child[i] = NULL;
+        }
+        upper_in->reset_prefix_keys(upper_in->data, upper_in->data_count);
+        upper.root = upper_in;
+        upper.height = height;
+        if (upper_in->data_count == 0) {
+            // 자식이 하나뿐인 노드는 그 자식만 남긴다
+            upper.root = upper_in->child[0];
+            upper.height = height - 1;
+            upper_in->remove_child(0);
+            delete_node(upper_in);
+        }
     }
 
-    // 자식이 없는 리프노드에서 target이 발견되지 않는경우 위의 if문을 모두
-    // 만족시키지 못하고 count의 값에는 0이 저장된다. 따라서 이 경우에는 그냥
-    // count를 반환하면 된다
+    // data[index]보다 왼쪽은 n에 남기고, 마지막 데이터는 n과 lower_middle
+    // 사이에 둔다
+    piece lower = {NULL, 0};
+    Item lower_sep;
+    size_t lower_mult = 0;
+    in->child[index] = NULL;
+    in->child_count = index;
+    if (index > 0) {
+        lower_sep = std::move(in->data[index - 1]);
+        lower_mult = in->multiplicity(index - 1);
+        in->data_count = index - 1;
+        in->reset_prefix_keys(in->data, in->data_count);
+        lower.root = in;
+        lower.height = height;
+        if (in->data_count == 0) {
+            lower.root = in->child[0];
+            lower.height = height - 1;
+            in->remove_child(0);
+        }
+    }
+    if (lower.root != in)
+        delete_node(in);
 
-    return count;
+    left = index > 0 ? join_pieces(lower, lower_sep, lower_mult, lower_middle)
+                     : lower_middle;
+    right = index < count
+                ? join_pieces(upper_middle, upper_sep, upper_mult, upper)
+                : upper_middle;
 }
 
-template <class Item> void bag<Item>::insert(const Item &entry) {
-    loose_insert(entry);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::piece
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::join_pieces(piece left, Item &sep,
+                                                         size_t mult,
+                                                         piece right) {
+    if (left.height == right.height) {
+        if (left.root == NULL) {
+            leaf_node *leaf = new_leaf();
+            leaf->insert_data(0, std::move(sep), mult);
+            piece joined = {leaf, 1};
+            return joined;
+        }
 
-    if (data_count == MAXIMUM + 1) {
-        // 최상위 노드가 MAXIMUM 조건을 만족시키지 못하므로 데이터를 부모로
-        // 올려야하는데, 최상위 노드는 부모노드가 존재하지 않는다. 따라서 현재
-        // 노드를 deep copy 후 현재 노드를 빈 bag으로 만든뒤 복사한 노드를
-        // 자식으로 삼는다.
-        bag *copy_this = new bag(*this); // 자신을 copy_this에 deep copy
-        clear();                         // 자신을 clear
-        insert_child(0, copy_this); // copy_this를 첫번째 자식으로 삼는다.
-        fix_excess(0); // child[0], 즉 copy_this가 MAXIMUM 조건을 만족시키지
-                       // 못하므로 fix_excess(0)를 호출한다.
+        // 높이가 같으면 sep 하나를 가진 새 최상위 노드의 두 자식으로 삼는다.
+        // 두 최상위 노드는 MINIMUM보다 적은 데이터를 가질수 있다.
+        internal_node *top = new_internal();
+        top->insert_data(0, std::move(sep), mult);
+        top->insert_child(0, left.root, subtree_size(left.root));
+        top->insert_child(1, right.root, subtree_size(right.root));
+        balance_children(top, 0);
+
+        piece joined = {top, left.height + 1};
+        if (top->data_count == 0) {
+            // 두 자식이 하나로 merge 되었다
+            joined.root = top->child[0];
+            joined.height = left.height;
+            top->remove_child(0);
+            delete_node(top);
+        }
+        return joined;
     }
-}
 
-template <class Item> void bag<Item>::loose_insert(const Item &entry) {
-    size_t index = 0;
+    piece joined = left.height > right.height ? left : right;
+    if (left.height > right.height)
+        graft(joined.root, joined.height, sep, mult, right, true);
+    else
+        graft(joined.root, joined.height, sep, mult, left, false);
 
-    while (data[index] < entry && index < data_count) {
-        ++index; // entry를 넣을 만한 data나 child의 index를 찾는다
+    if (joined.root->data_count == MAXIMUM + 1) {
+        // insert()처럼 넘친 최상위 노드를 새 최상위 노드의 자식으로 삼아
+        // 나눈다
+        internal_node *top = new_internal();
+        top->insert_child(0, joined.root, subtree_size(joined.root));
+        fix_excess(top, 0);
+        joined.root = top;
+        joined.height++;
     }
+    return joined;
+}
 
-    if (child_count != 0) { // 리프노드에 도달할때까지 재귀적으로 호출
-        child[index]->loose_insert(entry);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::graft(node *&n, size_t height,
+                                                        Item &sep, size_t mult,
+                                                        const piece &shorter,
+                                                        bool at_end) {
+    assert(height > shorter.height); // Precondition
 
-        /* 재귀 호출 후 child가 MAXIMUM 조건을 만족시키지 못하면 fix */
-        if (child[index]->data_count == MAXIMUM + 1)
-            fix_excess(index);
-    } else { // 리프노드라면 entry를 삽입
-        insert_data(index, entry);
+    make_writable(n);
+    if (height == shorter.height + 1) {
+        // 같은 높이가 되는 자리에 도착했다. 빈 트리는 sep만 리프노드에 넣는다.
+        if (shorter.root == NULL) {
+            n->insert_data(at_end ? n->data_count : 0, std::move(sep), mult);
+            return;
+        }
+        internal_node *in = static_cast<internal_node *>(n);
+        size_t total = subtree_size(shorter.root);
+        if (at_end) {
+            in->insert_data(in->data_count, std::move(sep), mult);
+            in->insert_child(in->child_count, shorter.root, total);
+            balance_children(in, in->child_count - 2);
+        } else {
+            in->insert_data(0, std::move(sep), mult);
+            in->insert_child(0, shorter.root, total);
+            balance_children(in, 0);
+        }
+        return;
     }
+
+    // 가장자리의 자식으로 내려간 후 넘친 자식을 나눈다
+    internal_node *in = static_cast<internal_node *>(n);
+    size_t i = at_end ? in->child_count - 1 : 0;
+    graft(in->child[i], height - 1, sep, mult, shorter, at_end);
+    in->set_child_total(i, subtree_size(in->child[i]));
+    if (in->child[i]->data_count == MAXIMUM + 1)
+        fix_excess(in, i);
 }
 
-template <class Item> void bag<Item>::fix_excess(size_t i) {
-    assert(i < child_count);                     // Precondition
-    assert(child[i]->data_count == MAXIMUM + 1); // Precondition
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::balance_children(
+    internal_node *n, size_t i) {
+    assert(i + 1 < n->child_count); // Precondition
 
-    bag *splited_child = new bag(); // 분리시킬 자식 서브트리
+    size_t left_count = n->child[i]->data_count;
+    size_t right_count = n->child[i + 1]->data_count;
+    if (left_count >= MINIMUM && right_count >= MINIMUM)
+        return;
 
-    /* 현재 노드에 child[i]의 중간 데이터 삽입 */
-    insert_data(i, child[i]->data[MINIMUM]);
+    if (left_count + 1 + right_count <= MAXIMUM) {
+        merge_child(n, i);
+        return;
+    }
 
-    /* 자식의 데이터 반을 분리 */
-    for (int j = 0; j < MINIMUM; j++) {
-        splited_child->data[j] = child[i]->data[MINIMUM + 1 + j];
+    // 두 자식의 데이터가 2 * MINIMUM 이상이므로 모자란 쪽으로 옮겨오면 두
+    // 자식 모두 MINIMUM 조건을 만족한다
+    while (n->child[i]->data_count < MINIMUM)
+        rotate_left(n, i);
+    while (n->child[i + 1]->data_count < MINIMUM)
+        rotate_right(n, i);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::piece
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::erase_every(node *n,
+                                                         size_t height,
+                                                         const Item &target,
+                                                         bool present,
+                                                         size_t &removed) {
+    instrument.add(&bag_counters::erase_visits);
+    // target과 같은 데이터는 data[first]부터 data[last - 1]까지 모여있다
+    size_t first = find_slot(n, target, false);
+    size_t last = find_slot(n, target, true);
+    for (size_t i = first; i < last; i++)
+        removed += n->multiplicity(i);
+
+    if (n->leaf) {
+        n->remove_range(first, last);
+        piece rest = {n, 1};
+        drop_empty_root(rest);
+        return rest;
     }
-    splited_child->data_count = MINIMUM;
-    child[i]->data_count = MINIMUM;
 
-    /* 자식이 자식을 가진다면 자식의 자식을 분리 */
-    if (child[i]->child_count != 0) {
-        for (int j = 0; j <= MINIMUM; j++) {
-            /* shallow copy(어떤 노드도 삭제되지 않기 때문에 deep copy를 할
-             * 필요가 없다) 후 분리된 자식의 자리는 모두 NULL로 할당 */
-            splited_child->child[j] = child[i]->child[MINIMUM + 1 + j];
-            child[i]->child[MINIMUM + 1 + j] = NULL;
+    internal_node *in = static_cast<internal_node *>(n);
+    if (first == last) {
+        // 이 노드에 target이 없다면 child[first] 하나만 내려간다. 공유하는
+        // 자식은 target이 있을때만 복사한다.
+        piece rest = {n, height};
+        const node *next = in->child[first];
+        if (!present && next->refs.load(std::memory_order_acquire) > 1) {
+            if (!holds(next, target))
+                return rest;
+            present = true;
         }
-        splited_child->child_count = MINIMUM + 1;
-        child[i]->child_count = MINIMUM + 1;
+        rest = erase_every(writable_child(in, first), height - 1, target,
+                           present, removed);
+        return place_piece(in, height, first, rest);
     }
 
-    insert_child(i + 1, splited_child); // 분리된 자식을 child[i+1]에 삽입
+    // child[first]와 child[last] 사이의 자식은 target만 가지고 있다. 양 끝의
+    // 자식은 join_pieces()로 바뀌므로 복사하지만, 그 아래는 target이 있는지
+    // 다시 확인한다.
+    for (size_t i = first + 1; i < last; i++) {
+        removed += count_subtree(in->child[i]);
+        release(in->child[i]);
+    }
+    piece lower = erase_every(writable_child(in, first), height - 1, target,
+                              false, removed);
+    piece upper = erase_every(writable_child(in, last), height - 1, target,
+                              false, removed);
+
+    // target들과 그 사이의 자식을 빼면 child[first] 자리 하나가 남는다
+    in->remove_range(first, last);
+    for (size_t i = first; i < last; i++)
+        in->remove_child(first + 1);
+
+    // 남은 두 트리는 lower의 가장 큰 데이터를 사이에 두고 잇는다
+    piece middle = lower.root == NULL ? upper : lower;
+    if (lower.root != NULL && upper.root != NULL) {
+        Item sep;
+        size_t mult;
+        remove_biggest(lower.root, sep, mult);
+        drop_empty_root(lower);
+        middle = join_pieces(lower, sep, mult, upper);
+    }
+
+    if (middle.height == height) {
+        // 이어붙인 트리가 넘쳐서 높아졌다면 그 최상위 노드의 데이터 하나와
+        // 두 자식을 in으로 옮긴다. in의 데이터는 target 수만큼 줄었으므로
+        // 넘치지 않는다.
+        internal_node *top = static_cast<internal_node *>(middle.root);
+        in->child[first] = top->child[1];
+        in->set_child_total(first, top->child_total(1));
+        in->insert_child(first, top->child[0], top->child_total(0));
+        in->insert_data(first, std::move(top->data[0]),
+                        top->multiplicity(0));
+        top->child_count = 0;
+        delete_node(top);
+        piece rest = {in, height};
+        return rest;
+    }
+    return place_piece(in, height, first, middle);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::piece
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::place_piece(internal_node *n,
+                                                         size_t height,
+                                                         size_t i, piece p) {
+    assert(p.height < height && i < n->child_count); // Precondition
+
+    if (n->data_count == 0) {
+        // p가 유일한 자식이므로 n 대신 p가 남는다
+        n->child_count = 0;
+        delete_node(n);
+        return p;
+    }
+
+    if (p.height + 1 == height) {
+        n->child[i] = p.root;
+        n->set_child_total(i, subtree_size(p.root));
+        if (p.root->data_count < MINIMUM)
+            balance_children(n, i > 0 ? i - 1 : i);
+    } else {
+        // 왼쪽 이웃이 있으면 그 오른쪽 끝에, 없으면 오른쪽 이웃의 왼쪽 끝에
+        // 둘 사이의 데이터와 함께 붙인다
+        size_t s = i > 0 ? i - 1 : 0;
+        Item sep = std::move(n->data[s]);
+        size_t mult = n->multiplicity(s);
+        n->remove_data(s);
+        n->remove_child(i);
+        graft(n->child[s], height - 1, sep, mult, p, i > 0);
+        n->set_child_total(s, subtree_size(n->child[s]));
+        if (n->child[s]->data_count == MAXIMUM + 1)
+            fix_excess(n, s);
+    }
+
+    piece rest = {n, height};
+    drop_empty_root(rest);
+    return rest;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::drop_empty_root(piece &p) {
+    if (p.root == NULL || p.root->data_count > 0)
+        return;
+
+    node *empty = p.root;
+    if (empty->leaf) {
+        p.root = NULL;
+        p.height = 0;
+    } else {
+        internal_node *in = static_cast<internal_node *>(empty);
+        p.root = in->child[0];
+        p.height--;
+        in->remove_child(0);
+    }
+    delete_node(empty);
 }
 
-template <class Item> bool bag<Item>::erase_one(const Item &target) {
-    if (count(target) == 0) // target이 없다면 false 반환
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::adopt_pools(bag &other) {
+    assert(pools && other.pools); // Precondition
+
+    if (pools == other.pools)
+        return true;
+    if (!(allocator == other.allocator))
         return false;
 
-    loose_erase(target);
-    if ((data_count == 0) && (child_count == 1)) {
-        // loose_erase() 후 최상위 노드의 data가 0개인 경우 최상위 노드의 자식을
-        // deep copy 후 현재 노드를 clear한 다음에 자식 노드를 현재노드로 deep
-        // copy 후 자식 노드를 삭제한다.
+    std::shared_ptr<node_pools> source;
+    if (other.pools.use_count() == 1) {
+        // other의 pool은 other만 가지고 있으므로 그 노드를 모두 가져온다
+        source.swap(other.pools);
+    } else if (pools.use_count() == 1) {
+        // other의 pool을 다른 bag이 함께 가지고 있으면 이 bag의 노드를 그
+        // pool로 옮기고 그 pool을 함께 가진다
+        source.swap(pools);
+        pools = other.pools;
+    } else {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::lock_guard<std::mutex> guard(pools->lock);
+    pools->leaf.adopt(source->leaf);
+    pools->internal.adopt(source->internal);
+    other.pools = pools;
+    return true;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::tree_height(const node *n) {
+    size_t height = 0;
+    while (n != NULL) {
+        height++;
+        n = n->leaf ? NULL : static_cast<const internal_node *>(n)->child[0];
+    }
+    return height;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_subtree(
+    const node *n) {
+    if (ORDER_STATS)
+        return subtree_size(n);
 
-        // 자식 노드를 child_copy로 deep copy
-        bag *child_copy = bag_copy(child[0]);
-        clear(); // 현재 노드 삭제
+    size_t total = 0;
+    for (size_t i = 0; i < n->data_count; i++)
+        total += n->multiplicity(i);
+    if (!n->leaf) {
+        const internal_node *in = static_cast<const internal_node *>(n);
+        for (size_t i = 0; i < in->child_count; i++)
+            total += count_subtree(in->child[i]);
+    }
+    return total;
+}
 
-        // 자식 노드를 현재 노드로 deep copy
-        data_count = child_copy->data_count;
-        for (size_t i = 0; i < data_count; i++) {
-            data[i] = child_copy->data[i];
-        }
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::combine(const bag &other,
+                                                          set_operation op) {
+    if (other.item_count == 0 && op != SET_MIN)
+        return;
 
-        child_count = child_copy->child_count;
-        for (size_t i = 0; i < child_count; i++) {
-            child[i] = bag_copy(child_copy->child[i]);
+    // run-length 모드에서는 개수만큼 삽입, 삭제를 반복하게 되므로 항상
+    // 트리를 다시 만든다
+    if (!RUN_LENGTH && &other != this &&
+        other.item_count * BULK_REBUILD_RATIO < item_count) {
+        combine_small(other, op);
+        return;
+    }
+
+    // 두 트리를 함께 순회하면서 데이터마다 두 개수를 세어 합친다. 결과를
+    // 모두 모을 때까지 기존 트리는 그대로 둔다.
+    item_buffer items(allocator);
+    std::vector<size_t> mults;
+    size_t total = 0;
+    const_iterator a = begin(), b = other.begin();
+    while (a != end() || b != end()) {
+        // 한쪽이 끝나면 더 이상 결과가 바뀌지 않는 경우
+        if ((op == SET_MIN && (a == end() || b == end())) ||
+            (op == SET_DIFFERENCE && a == end()))
+            break;
+
+        const Item *key;
+        size_t count_a = 0, count_b = 0;
+        if (b == end() || (a != end() && comparator(*a, *b))) {
+            key = &*a;
+            count_a = next_run(a);
+        } else if (a == end() || comparator(*b, *a)) {
+            key = &*b;
+            count_b = next_run(b);
+        } else {
+            key = &*a;
+            count_a = next_run(a);
+            count_b = next_run(b);
         }
 
-        // 자식 노드 삭제
-        child_copy->clear();
+        size_t c = combined_count(count_a, count_b, op);
+        if (c == 0)
+            continue;
+        total += c;
+        if (RUN_LENGTH) {
+            items.push_back(*key);
+            mults.push_back(c);
+        } else {
+            items.insert(items.end(), c, *key);
+        }
     }
 
-    return true;
+    clear();
+    build_sorted(items.data(), RUN_LENGTH ? mults.data() : NULL,
+                 items.size(), 1.0);
+    item_count = total;
 }
 
-template <class Item> void bag<Item>::loose_erase(const Item &target) {
-    size_t index = 0;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::combine_small(
+    const bag &other, set_operation op) {
+    assert(&other != this); // Precondition
 
-    while (data[index] < target && index < data_count) {
-        ++index; // target이 있을 만한 data나 child의 index를 찾는다
+    const_iterator b = other.begin();
+    if (op == SET_MIN) {
+        // 결과는 other보다 작으므로 모아서 트리를 다시 만든다
+        item_buffer items(allocator);
+        while (b != end()) {
+            const Item &key = *b;
+            size_t c = std::min(count(key), next_run(b));
+            items.insert(items.end(), c, key);
+        }
+        clear();
+        build_sorted(items.data(), NULL, items.size(), 1.0);
+        item_count = items.size();
+        return;
     }
 
-    if ((index < data_count) && (data[index] == target)) {
-        if (child_count == 0) {
-            // 리프노드에서 target을 발견했다면 그냥 삭제한다.
-            remove_data(index);
+    // other와 노드를 공유하더라도 삽입과 삭제는 공유하는 노드를 복사해서
+    // 바꾸므로 b는 계속 사용할수 있다
+    while (b != end()) {
+        const Item &key = *b;
+        size_t count_b = next_run(b);
+        if (op == SET_DIFFERENCE) {
+            for (size_t j = 0; j < count_b && erase_one(key); j++)
+                ;
         } else {
-            // 리프노드가 아닌 노드에서 target을 찾았다면 왼쪽 서브트리에서 가장
-            // 큰 값을 target 자리에 놓고 해당 값을 삭제한다.
-            child[index]->remove_biggest(data[index]);
+            size_t have = (op == SET_MAX) ? count(key) : 0;
+            for (size_t j = have; j < count_b; j++)
+                insert(key);
+        }
+    }
+}
 
-            if (child[index]->data_count == MINIMUM - 1)
-                // fix_shortage()는 자식을 fix하는 것이므로 child[i]에 대해서는
-                // 여기서 fix해 주어야 한다.
-                fix_shortage(index);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::combined_count(
+    size_t a, size_t b, set_operation op) {
+    switch (op) {
+    case SET_SUM:
+        return a + b;
+    case SET_MAX:
+        return std::max(a, b);
+    case SET_MIN:
+        return std::min(a, b);
+    case SET_DIFFERENCE:
+        return a > b ? a - b : 0;
+    }
+    return 0;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::next_run(
+    const_iterator &it) const {
+    assert(it.depth != 0); // Precondition
+
+    // non run-length 모드에서는 같은 데이터가 여러 자리에 이어져 있다
+    const Item &key = *it;
+    size_t count = 0;
+    do {
+        count += it.multiplicity();
+        it.next_slot();
+    } while (it.depth != 0 && !comparator(key, *it));
+    return count;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::build_sorted(
+    Item *items, const size_t *mults, size_t m, double fill) {
+    assert(root == NULL);           // Precondition
+    assert(0 < fill && fill <= 1);  // Precondition
+
+    if (m == 0)
+        return;
+
+    // 노드 하나에 채울 데이터 수의 목표
+    size_t target = static_cast<size_t>(fill * MAXIMUM + 0.5);
+    if (target < MINIMUM)
+        target = MINIMUM;
+    if (target > MAXIMUM)
+        target = MAXIMUM;
+
+    // children은 아래 층에서 만든 노드들과 그 서브트리의 데이터 수이고,
+    // seps는 그 노드들 사이의 데이터로 현재 층에 나눠 넣을 데이터이다.
+    std::vector<node *> children, parents;
+    std::vector<size_t> totals, parent_totals;
+    item_buffer seps(allocator), next_seps(allocator);
+    std::vector<size_t> sep_mults, next_sep_mults;
+    bool leaf_level = true;
+
+    for (;;) {
+        size_t nodes = level_node_count(m, target);
+        size_t data = m - (nodes - 1); // 노드에 들어갈 데이터의 수
+        size_t pos = 0;                // 다음에 넣을 데이터의 위치
+        size_t c = 0;                  // 다음에 넣을 자식의 위치
+
+        parents.clear();
+        parent_totals.clear();
+        next_seps.clear();
+        next_sep_mults.clear();
+
+        for (size_t j = 0; j < nodes; j++) {
+            // 데이터를 노드마다 고르게 나눈다. 앞쪽 노드들이 하나씩 더 가진다.
+            size_t k = data / nodes + (j < data % nodes ? 1 : 0);
+            node *n;
+            size_t total = 0;
+
+            if (leaf_level) {
+                n = new_leaf();
+            } else {
+                internal_node *in = new_internal();
+                for (size_t d = 0; d <= k; d++, c++) {
+                    in->insert_child(d, children[c], totals[c]);
+                    total += totals[c];
+                }
+                n = in;
+            }
+            for (size_t d = 0; d < k; d++, pos++) {
+                size_t mult = (mults != NULL) ? mults[pos] : 1;
+                n->insert_data(d, std::move(items[pos]), mult);
+                total += mult;
+            }
+            n->reset_prefix_keys(n->data, n->data_count);
+
+            // 노드 사이의 데이터는 다음 층으로 올린다
+            if (j + 1 < nodes) {
+                next_seps.push_back(std::move(items[pos]));
+                next_sep_mults.push_back((mults != NULL) ? mults[pos] : 1);
+                pos++;
+            }
+            parents.push_back(n);
+            parent_totals.push_back(total);
         }
-    } else if (child_count != 0) {
-        // target을 발견하지 못했으면 리프노드에 도달할때까지 재귀적으로 호출
-        child[index]->loose_erase(target);
 
-        if (child[index]->data_count == MINIMUM - 1)
-            // 재귀적으로 호출후 child[index]가 MINUMUM 조건을 만족하지 않을시
-            // fix한다.
-            fix_shortage(index);
+        if (nodes == 1) { // 노드가 하나뿐인 층이 최상위 노드가 된다
+            root = parents[0];
+            return;
+        }
+
+        children.swap(parents);
+        totals.swap(parent_totals);
+        seps.swap(next_seps);
+        sep_mults.swap(next_sep_mults);
+        items = seps.data();
+        mults = sep_mults.data();
+        m = seps.size();
+        leaf_level = false;
     }
 }
 
-template <class Item> void bag<Item>::fix_shortage(size_t i) {
-    assert(i < child_count);                     // Precondition
-    assert(child[i]->data_count == MINIMUM - 1); // Precondition
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::level_node_count(
+    size_t m, size_t target) {
+    assert(m > 0); // Precondition
 
-    if (i > 0 && child[i - 1]->data_count > MINIMUM) {
-        /* 왼쪽 서브트리에게 데이터를 하나 받아온다 */
-        size_t last_index = child[i - 1]->data_count - 1;
+    if (m <= MAXIMUM)
+        return 1;
+
+    // 노드 수가 x이면 노드의 데이터 수의 합은 m - (x - 1) 이므로, 각 노드가
+    // MINIMUM 이상 MAXIMUM 이하를 가지려면
+    //   (m + 1) / (MAXIMUM + 1) <= x <= (m + 1) / (MINIMUM + 1)
+    // 이어야 한다. 위쪽 경계를 내림한 값은 m > MAXIMUM 일때 항상 이 조건을
+    // 만족한다.
+    size_t nodes = (m + target + 1) / (target + 1);
+    size_t low = (m + MAXIMUM + 1) / (MAXIMUM + 1);
+    size_t high = (m + 1) / (MINIMUM + 1);
+    if (nodes < low)
+        nodes = low;
+    if (nodes > high)
+        nodes = high;
+    return nodes;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::sort_items(
+    Item *first, Item *last, const Compare &less) {
+    size_t n = last - first;
+    size_t threads = std::thread::hardware_concurrency();
+    if (threads > n / PARALLEL_SORT_MIN)
+        threads = n / PARALLEL_SORT_MIN;
+    if (threads < 2) {
+        std::sort(first, last, less);
+        return;
+    }
 
-        // data[i-1]을 child[i]의 첫번째에 삽입한다
-        child[i]->insert_data(0, data[i - 1]);
+    // 구간을 스레드 수만큼 나눠 각각 정렬한다
+    std::vector<Item *> bounds;
+    for (size_t t = 0; t <= threads; t++)
+        bounds.push_back(first + n * t / threads);
 
-        // data[i-1]에 child[i-1]의 마지막 데이터를 가져와서 저장한다
-        data[i - 1] = child[i - 1]->data[last_index];
-        child[i - 1]->remove_data(last_index);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++)
+        workers.push_back(std::thread(
+            [&less](Item *lo, Item *hi) { std::sort(lo, hi, less); },
+            bounds[t], bounds[t + 1]));
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
 
-        // child[i]에 자식이 존재한다면 child[i-1]의 마지막 자식을 child[i]의
-        // 첫번째 자식으로 삼는다
-        if (child[i]->child_count != 0) {
-            last_index = child[i - 1]->child_count - 1;
-            child[i]->insert_child(0, child[i - 1]->child[last_index]);
-            child[i - 1]->remove_child(last_index);
+    // 이웃한 두 구간씩 병렬로 merge 하면서 구간의 수를 반씩 줄인다
+    while (bounds.size() > 2) {
+        std::vector<Item *> merged_bounds;
+        workers.clear();
+        size_t r;
+        for (r = 0; r + 2 < bounds.size(); r += 2) {
+            workers.push_back(std::thread(
+                [&less](Item *lo, Item *mid, Item *hi) {
+                    std::inplace_merge(lo, mid, hi, less);
+                },
+                bounds[r], bounds[r + 1], bounds[r + 2]));
+            merged_bounds.push_back(bounds[r]);
         }
-    } else if ((i < child_count - 1) && (child[i + 1]->data_count > MINIMUM)) {
-        /* 오른쪽 서브트리에게 데이터를 하나 받아온다 */
+        if (r + 1 < bounds.size()) // 짝이 없는 마지막 구간은 그대로 둔다
+            merged_bounds.push_back(bounds[r]);
+        merged_bounds.push_back(last);
+        for (size_t t = 0; t < workers.size(); t++)
+            workers[t].join();
+        bounds.swap(merged_bounds);
+    }
+}
 
-        // data[i]를 child[i]의 마지막에 삽입한다
-        child[i]->insert_data(MINIMUM - 1, data[i]);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::rank(
+    const Item &target) const {
+    static_assert(ORDER_STATS, "rank() needs BAG_ORDER_STATS");
+    instrument.add(&bag_counters::lookup_calls);
+    return rank_bound(target, false);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key, class C, class>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::rank(
+    const Key &target) const {
+    static_assert(ORDER_STATS, "rank() needs BAG_ORDER_STATS");
+    instrument.add(&bag_counters::lookup_calls);
+    return rank_bound(target, false);
+}
 
-        // child[i+1]의 첫번때 데이터를 data[i]에 저장한다
-        data[i] = child[i + 1]->data[0];
-        child[i + 1]->remove_data(0);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+const Item &bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::select(
+    size_t k) const {
+    static_assert(ORDER_STATS, "select() needs BAG_ORDER_STATS");
+    assert(k < item_count); // Precondition
 
-        // child[i]에 자식이 존재한다면 child[i+1]의 첫번째 자식을 child[i]의
-        // 마지막 자식으로 삼는다
-        if (child[i]->child_count != 0) {
-            child[i]->insert_child(MINIMUM, child[i + 1]->child[0]);
-            child[i + 1]->remove_child(0);
+    // 각 노드에서 앞쪽 자식 서브트리와 데이터의 수를 k에서 빼면서 k번째
+    // 데이터가 들어있는 자리를 찾는다
+    const node *n = root;
+    for (;;) {
+        const internal_node *in =
+            n->leaf ? NULL : static_cast<const internal_node *>(n);
+        size_t i;
+        for (i = 0; i < n->data_count; i++) {
+            if (in != NULL) {
+                if (k < in->child_total(i))
+                    break;
+                k -= in->child_total(i);
+            }
+            if (k < n->multiplicity(i))
+                return n->data[i];
+            k -= n->multiplicity(i);
         }
-    } else if (i > 0) {
-        // 왼쪽 child와 merge 한다
-        merge_child(i - 1);
-    } else {
-        // 오른쪽 child와 merge 한다
-        merge_child(i);
+        assert(in != NULL); // 리프노드라면 위에서 반환되었어야 한다
+        n = in->child[i];
     }
 }
 
-template <class Item> void bag<Item>::remove_biggest(Item &removed_enrty) {
-    if (child_count == 0) {
-        // 가장 오른쪽 리프노드의 가장 오른쪽 데이터가 가장 큰 값이므로 해당
-        // 데이터를 removed_enrty에 저장후 삭제한다
-        removed_enrty = data[--data_count];
-    } else {
-        // 가장 오른쪽 자식노드에 대해 재귀적으로 호출한다
-        child[child_count - 1]->remove_biggest(removed_enrty);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+const Item &bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::quantile(
+    double q) const {
+    static_assert(ORDER_STATS, "quantile() needs BAG_ORDER_STATS");
+    assert(item_count > 0);  // Precondition
+    assert(0 <= q && q <= 1); // Precondition
 
-        // 가장 오른쪽 자식이 MINIMUM 조건을 불만족하면 fix한다
-        if (child[child_count - 1]->data_count == MINIMUM - 1)
-            fix_shortage(child_count - 1);
+    size_t k = static_cast<size_t>(std::ceil(q * item_count));
+    if (k > 0)
+        --k;
+    if (k >= item_count) // 부동소수점 오차로 범위를 넘는 경우
+        k = item_count - 1;
+    return select(k);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::rank_bound(
+    const Key &target, bool upper) const {
+    size_t rank = 0;
+    const node *n = root;
+
+    // 내려가는 자식보다 앞에 있는 자식 서브트리와 데이터의 수를 더한다
+    while (n != NULL) {
+        instrument.add(&bag_counters::lookup_visits);
+        size_t index = find_slot(n, target, upper);
+        for (size_t i = 0; i < index; i++)
+            rank += n->multiplicity(i);
+        if (n->leaf)
+            break;
+
+        const internal_node *in = static_cast<const internal_node *>(n);
+        for (size_t i = 0; i < index; i++)
+            rank += in->child_total(i);
+        n = in->child[index];
     }
+    return rank;
 }
 
-template <class Item> void bag<Item>::show_contents() { show_contents_rec(0); }
-template <class Item> void bag<Item>::show_contents_rec(size_t depth) {
-    int i;
-    if (child_count != 0) {
-        // 오른쪽 자식을 먼저 재귀적으로 모두 출력후 데이터를 출력한다
-        for (i = child_count - 1; i > 0; i--) {
-            child[i]->show_contents_rec(depth + 1);
-            std::cout << std::setw(4 * depth) << "" << data[i - 1] << std::endl;
-        }
-        // 가장 왼쪽 자식을 재귀적으로 출력한다
-        child[i]->show_contents_rec(depth + 1);
-    } else {
-        // 리프노드는 자식이 없으므로 데이터를 한번에 모두 출력한다
-        for (i = data_count - 1; i >= 0; i--) {
-            std::cout << std::setw(4 * depth) << "" << data[i] << std::endl;
-        }
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::subtree_size(
+    const node *n) {
+    if (!ORDER_STATS)
+        return 0;
+
+    size_t total = 0;
+    for (size_t i = 0; i < n->data_count; i++)
+        total += n->multiplicity(i);
+    if (!n->leaf) {
+        const internal_node *in = static_cast<const internal_node *>(n);
+        for (size_t i = 0; i < in->child_count; i++)
+            total += in->child_total(i);
     }
+    return total;
 }
 
-template <class Item> void bag<Item>::insert_data(size_t i, const Item &entry) {
-    assert(i <= data_count); // Precondition
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::begin() const {
+    const_iterator it;
+    if (root != NULL)
+        it.descend_leftmost(root);
+    return it;
+}
 
-    // 데이터를 한칸씩 뒤로 민다
-    for (size_t j = data_count; j > i; j--)
-        data[j] = data[j - 1];
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::end() const {
+    return const_iterator();
+}
 
-    data[i] = entry;
-    data_count++;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::lower_bound(
+    const Item &target) const {
+    return find_bound(target, false);
 }
 
-template <class Item> void bag<Item>::insert_child(size_t i, bag *child) {
-    assert(i <= child_count); // Precondition
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key, class C, class>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::lower_bound(
+    const Key &target) const {
+    return find_bound(target, false);
+}
 
-    // 자식을 한칸씩 뒤로 민다
-    for (size_t j = child_count; j > i; j--)
-        this->child[j] = this->child[j - 1];
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::upper_bound(
+    const Item &target) const {
+    return find_bound(target, true);
+}
 
-    this->child[i] = child;
-    child_count++;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key, class C, class>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::upper_bound(
+    const Key &target) const {
+    return find_bound(target, true);
 }
 
-template <class Item> void bag<Item>::remove_data(size_t i) {
-    assert(i < data_count); // Precondition
-    data_count--;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+std::pair<typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator,
+          typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::equal_range(
+    const Item &target) const {
+    return std::make_pair(find_bound(target, false),
+                          find_bound(target, true));
+}
 
-    // 데이터를 한칸씩 앞으로 당긴다
-    for (; i < data_count; i++)
-        data[i] = data[i + 1];
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key, class C, class>
+std::pair<typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator,
+          typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::equal_range(
+    const Key &target) const {
+    return std::make_pair(find_bound(target, false),
+                          find_bound(target, true));
 }
 
-template <class Item> void bag<Item>::remove_child(size_t i) {
-    assert(i < child_count); // Precondition
-    child_count--;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_range(
+    const Item &lo, const Item &hi) const {
+    return count_between(lo, hi);
+}
 
-    // 자식을 한칸씩 앞으로 당긴다
-    for (; i < child_count; i++)
-        child[i] = child[i + 1];
-    child[child_count] = NULL;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key, class C, class>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_range(
+    const Key &lo, const Key &hi) const {
+    return count_between(lo, hi);
 }
 
-template <class Item> void bag<Item>::merge_child(size_t i) {
-    assert(i < child_count - 1); // Precondition
-    size_t append_index = child[i]->data_count;
-    size_t left_index, right_index;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::count_between(
+    const Key &lo, const Key &hi) const {
+    if (ORDER_STATS) {
+        // 범위 양 끝의 순위 차이가 곧 범위 안의 데이터 수이다
+        if (comparator(hi, lo))
+            return 0;
+        return rank_bound(hi, true) - rank_bound(lo, false);
+    }
 
-    // data[i]을 child[i]의 마지막에 삽입한다
-    child[i]->insert_data(append_index, data[i]);
-    remove_data(i);
+    size_t count = 0;
 
-    // child[i+1]의 모든 데이터를 child[i]의 끝으로 이동시킨다
-    for (left_index = append_index + 1; left_index < MAXIMUM; left_index++) {
-        right_index = left_index - append_index - 1;
-        child[i]->insert_data(left_index, child[i + 1]->data[right_index]);
+    // 같은 데이터는 한번에 개수를 더하고 다음 자리로 넘어간다
+    for (const_iterator it = find_bound(lo, false);
+         it.depth != 0 && !comparator(hi, *it); it.next_slot()) {
+        count += it.multiplicity();
     }
+    return count;
+}
 
-    // child[i]에 자식이 존재하면 child[i+1]의 모든 자식을 child[i]의 끝으로
-    // 이동시킨다
-    if (child[i]->child_count != 0) {
-        append_index = child[i]->child_count;
-        for (left_index = append_index; left_index <= MAXIMUM; left_index++) {
-            right_index = left_index - append_index;
-            child[i]->insert_child(left_index,
-                                   bag_copy(child[i + 1]->child[right_index]));
-        }
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::find_bound(const Key &target,
+                                                        bool upper) const {
+    const_iterator it;
+    const node *n = root;
+
+    // 각 노드에서 target이 들어갈 위치를 경로에 기록하면서 리프노드까지
+    // 내려간다. 리프노드에서 찾은 위치가 노드의 끝이라면 settle()이 다음
+    // 데이터가 있는 조상 노드로 올라간다.
+    while (n != NULL) {
+        size_t index = find_slot(n, target, upper);
+        it.push(n, index);
+        if (n->leaf)
+            break;
+        n = static_cast<const internal_node *>(n)->child[index];
     }
+    if (it.depth != 0)
+        it.settle();
+    return it;
+}
 
-    // child[i+1]을 삭제한다
-    child[i + 1]->clear();
-    remove_child(i + 1);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::find_slot(
+    const node *n, const Key &target, bool upper) const {
+    return find_slot(n, target, upper, prefix_lookup<Key>());
 }
 
-template <class Item> void bag<Item>::clear() {
-    if (child_count != 0) {
-        // 자식이 존재한다면 리프노드에 도달할때까지 재귀적으로 자식들을 모두
-        // delete 한다
-        for (size_t i = 0; i < child_count; i++) {
-            child[i]->clear(); // 먼저 child[i]의 모든 자식들을 clear() 한다
-            delete child[i]; // 그후 child[i]를 delete 한다
-            child[i] = NULL; // 또한 child[i]를 NULL로 설정한다
-        }
-        child_count = 0;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::find_slot(
+    const node *n, const Key &target, bool upper, std::false_type) const {
+    // SIMD 커널은 Item끼리만 비교할수 있다
+    typedef typename std::conditional<std::is_same<Key, Item>::value, search,
+                                      bag_scalar_search<Item, Compare>>::type
+        kernel;
+    return upper ? kernel::upper_bound(n->data, n->data_count, target,
+                                       comparator)
+                 : kernel::lower_bound(n->data, n->data_count, target,
+                                       comparator);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+template <class Key>
+size_t bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::find_slot(
+    const node *n, const Key &target, bool upper, std::true_type) const {
+    std::string_view text(target);
+    size_t skip = n->key_skip;
+
+    // 노드의 데이터는 모두 앞부분 skip 바이트가 같으므로, target의 앞부분이
+    // 다르다면 노드의 맨 앞이나 맨 뒤가 답이다
+    if (skip > 0 && n->data_count > 0) {
+        int order = text.compare(
+            0, skip, std::string_view(n->data[0].data(), skip));
+        if (order != 0)
+            return order < 0 ? 0 : n->data_count;
     }
-    data_count = 0;
+
+    uint64_t key = bag_prefix_key(text, skip);
+    return upper ? bag_prefix_search::upper_bound(n->key, n->data,
+                                                  n->data_count, text, key)
+                 : bag_prefix_search::lower_bound(n->key, n->data,
+                                                  n->data_count, text, key);
 }
 
-template <class Item> bag<Item> *bag_copy(bag<Item> *source) {
-    if (source == NULL) // source가 NULL이면 그냥 NULL을 반환한다
-        return NULL;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::const_iterator()
+    : depth(0), rep(0) {}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::reference
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::operator*() const {
+    assert(depth != 0); // Precondition
+    return path[depth - 1].n->data[path[depth - 1].index];
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::pointer
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::operator->()
+    const {
+    return &**this;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator &
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::operator++() {
+    assert(depth != 0); // Precondition
+
+    // run-length 모드에서는 같은 데이터를 그 개수만큼 방문한다
+    if (++rep < multiplicity())
+        return *this;
+    next_slot();
+    return *this;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+typename bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::operator++(int) {
+    const_iterator old = *this;
+    ++*this;
+    return old;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::operator==(
+    const const_iterator &other) const {
+    if (depth == 0 || other.depth == 0)
+        return depth == other.depth;
+    return path[depth - 1].n == other.path[other.depth - 1].n &&
+           path[depth - 1].index == other.path[other.depth - 1].index &&
+           rep == other.rep;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bool bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::operator!=(
+    const const_iterator &other) const {
+    return !(*this == other);
+}
 
-    bag<Item> *copy_node = new bag<Item>(); // 복사해서 반환할 bag
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::push(
+    const node *n, size_t index) {
+    assert(depth < MAX_HEIGHT);
+    path[depth].n = n;
+    path[depth].index = index;
+    ++depth;
+}
 
-    for (size_t i = 0; i < source->data_count; i++) { // 데이터를 먼저 복사한다
-        copy_node->data[i] = source->data[i];
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::descend_leftmost(
+    const node *n) {
+    while (!n->leaf) {
+        push(n, 0);
+        n = static_cast<const internal_node *>(n)->child[0];
     }
-    copy_node->data_count = source->data_count;
+    push(n, 0);
+    rep = 0;
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::settle() {
+    // 맨 위 노드의 데이터를 모두 방문했다면 아직 방문하지 않은 데이터가 있는
+    // 조상 노드까지 올라간다. 그런 조상이 없다면 end()가 된다.
+    while (depth != 0 &&
+           path[depth - 1].index >= path[depth - 1].n->data_count)
+        --depth;
+    rep = 0;
+}
 
-    for (size_t i = 0; i < source->child_count; i++) {
-        // 자식이 존재할경우 copy_child에 재귀적으로 복사한다
-        bag<Item> *copy_child = new bag<Item>();
-        copy_child = bag_copy(source->child[i]);
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+void bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::next_slot() {
+    assert(depth != 0); // Precondition
 
-        // 복사한 자식을 cop_node의 자식으로 삼는다
-        copy_node->child[i] = copy_child;
+    frame &top = path[depth - 1];
+    ++top.index;
+    if (top.n->leaf) {
+        // 리프노드에서는 같은 노드의 다음 데이터로 이동한다
+        settle();
+    } else {
+        // 내부노드에서는 방금 방문한 데이터의 오른쪽 자식에서 가장 작은
+        // 데이터로 이동한다
+        descend_leftmost(
+            static_cast<const internal_node *>(top.n)->child[top.index]);
     }
-    copy_node->child_count = source->child_count;
+}
 
-    return copy_node;
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+size_t
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare>::const_iterator::multiplicity()
+    const {
+    return path[depth - 1].n->multiplicity(path[depth - 1].index);
+}
+
+template <class Item, size_t MINIMUM, class Alloc, unsigned OPTIONS,
+          class Compare>
+bag<Item, MINIMUM, Alloc, OPTIONS, Compare> *
+bag_copy(bag<Item, MINIMUM, Alloc, OPTIONS, Compare> *source) {
+    if (source == NULL) // source가 NULL이면 그냥 NULL을 반환한다
+        return NULL;
+
+    return new bag<Item, MINIMUM, Alloc, OPTIONS, Compare>(*source);
 }
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef BAG_FILE_H
+#define BAG_FILE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+/* bag_file은 bag을 파일에 저장하는 페이지 형식입니다. 파일은 BAG_PAGE_SIZE
+ * 크기의 페이지로 나뉘고, 노드는 포인터 대신 페이지 번호로 서로를 가리킵니다.
+ * 따라서 파일을 mmap 하면 역직렬화 없이 바로 검색할수 있습니다(mapped_bag.h).
+ *
+ *   페이지 0       : bag_file_header
+ *   리프 페이지    : (데이터, 개수) 쌍을 오름차순으로 저장한다. 같은 데이터는
+ *                    한번만 저장하고 개수를 센다. next는 다음 리프 페이지이다.
+ *   내부 페이지    : 자식 페이지 번호, 자식 서브트리의 데이터 수, 자식 사이의
+ *                    구분 데이터를 저장한다. key[i]는 child[i+1]의 가장 작은
+ *                    데이터이다(B+-tree).
+ *
+ * 리프 페이지가 파일 앞쪽에 순서대로 놓이고 그 위의 층들이 차례로 뒤에 놓입니다.
+ * 숫자는 모두 저장한 기계의 바이트 순서를 따르며, 헤더의 byte_order로 다른
+ * 기계에서 만든 파일을 거부합니다. */
+
+static const size_t BAG_PAGE_SIZE = 4096;
+
+// bag_file_header는 파일의 첫 페이지에 저장되는 정보입니다.
+struct bag_file_header {
+    char magic[8];       // "BAGFILE"
+    uint32_t version;    // 형식의 버전
+    uint32_t byte_order; // 0x01020304
+    uint32_t page_size;  // BAG_PAGE_SIZE
+    uint32_t item_size;  // sizeof(Item)
+    uint32_t height;     // 트리의 층 수. 비어있다면 0
+    uint32_t reserved;
+    uint64_t item_count; // 같은 데이터도 각각 센 데이터의 수
+    uint64_t page_count; // 헤더를 포함한 파일의 페이지 수
+    uint64_t root;       // 최상위 페이지의 번호. 비어있다면 0
+    uint64_t first_leaf; // 가장 작은 데이터가 있는 리프 페이지의 번호
+};
+
+// bag_page_header는 모든 노드 페이지의 앞부분입니다.
+struct bag_page_header {
+    uint32_t leaf;  // 리프 페이지이면 1
+    uint32_t count; // 리프는 데이터 쌍의 수, 내부 페이지는 자식의 수
+    uint64_t next;  // 리프 페이지에서 다음 리프의 번호. 마지막이면 0
+};
+
+// bag_page_layout은 Item에 따라 정해지는 페이지 안의 배열 위치입니다.
+//   리프 페이지    : 헤더, counts[LEAF_SLOTS], keys[LEAF_SLOTS]
+//   내부 페이지    : 헤더, child[FANOUT], totals[FANOUT], keys[FANOUT - 1]
+// 8바이트 배열을 앞에 두어 keys의 정렬을 맞춘다.
+template <class Item> struct bag_page_layout {
+    static_assert(std::is_trivially_copyable<Item>::value,
+                  "bag files need a trivially copyable Item");
+    static_assert(alignof(Item) <= 8, "bag files need alignof(Item) <= 8");
+
+    static const size_t HEADER = sizeof(bag_page_header);
+    static const size_t LEAF_SLOTS =
+        (BAG_PAGE_SIZE - HEADER) / (sizeof(Item) + sizeof(uint64_t));
+    static const size_t FANOUT = (BAG_PAGE_SIZE - HEADER + sizeof(Item)) /
+                                 (sizeof(Item) + 2 * sizeof(uint64_t));
+
+    static_assert(LEAF_SLOTS >= 1 && FANOUT >= 2,
+                  "Item is too large for a bag file page");
+
+    static const bag_page_header *header(const void *page) {
+        return static_cast<const bag_page_header *>(page);
+    }
+    static const uint64_t *leaf_counts(const void *page) {
+        return reinterpret_cast<const uint64_t *>(
+            static_cast<const char *>(page) + HEADER);
+    }
+    static const Item *leaf_keys(const void *page) {
+        return reinterpret_cast<const Item *>(
+            static_cast<const char *>(page) + HEADER +
+            LEAF_SLOTS * sizeof(uint64_t));
+    }
+    static const uint64_t *children(const void *page) {
+        return reinterpret_cast<const uint64_t *>(
+            static_cast<const char *>(page) + HEADER);
+    }
+    static const uint64_t *totals(const void *page) {
+        return children(page) + FANOUT;
+    }
+    static const Item *internal_keys(const void *page) {
+        return reinterpret_cast<const Item *>(totals(page) + FANOUT);
+    }
+};
+
+// bag_file_writer는 오름차순으로 들어오는 (데이터, 개수)를 페이지 형식으로
+// 파일에 쓰는 클래스입니다. 리프 페이지는 가득 찰때마다 바로 쓰고, 내부
+// 페이지는 각 리프의 첫 데이터만 모아두었다가 finish()에서 한층씩 씁니다.
+template <class Item> class bag_file_writer {
+  public:
+    bag_file_writer();
+    ~bag_file_writer();
+
+    // open() 함수는 path에 새 파일을 만들고 헤더 자리를 비워두는 함수입니다.
+    // Pre : None.
+    // Post : 파일을 만들었다면 true 반환.
+    bool open(const char *path);
+
+    // add() 함수는 데이터 entry를 mult개 추가하는 함수입니다. 바로 전에
+    // 추가한 데이터와 같다면 개수만 늘립니다.
+    // Pre : open()이 성공했고, entry는 이전에 추가한 데이터보다 작지 않다.
+    //       mult > 0
+    // Post : entry가 mult개 추가된다. entry가 이전 데이터보다 작다면 추가하지
+    //        않고 finish()가 false를 반환하게 한다.
+    void add(const Item &entry, uint64_t mult);
+
+    // finish() 함수는 남은 리프와 내부 페이지, 헤더를 쓰고 파일을 닫는
+    // 함수입니다.
+    // Pre : open()이 성공했다.
+    // Post : 쓰기가 모두 성공했고 데이터가 모두 순서대로 들어왔다면 true 반환.
+    bool finish();
+
+  private:
+    typedef bag_page_layout<Item> layout;
+
+    FILE *file;
+    bool failed;                   // 쓰기나 순서 검사에 실패한 적이 있는지
+    uint64_t page_count;           // 지금까지 쓴 페이지 수
+    uint64_t item_count;           // 지금까지 추가한 데이터 수
+    std::vector<uint64_t> page;    // 만들고 있는 페이지. 8바이트 정렬
+    std::vector<Item> first_keys;  // 아래 층 각 페이지의 첫 데이터
+    std::vector<uint64_t> pages;   // 아래 층 각 페이지의 번호
+    std::vector<uint64_t> totals;  // 아래 층 각 페이지의 데이터 수
+    uint64_t leaf_total;           // 만들고 있는 리프의 데이터 수
+
+    bag_page_header *header() {
+        return reinterpret_cast<bag_page_header *>(&page[0]);
+    }
+
+    // flush_leaf()는 만들고 있는 리프 페이지를 쓰는 함수입니다. last가
+    // false이면 다음 리프가 바로 다음 페이지에 온다.
+    void flush_leaf(bool last);
+
+    // write_page()는 page를 파일의 끝에 쓰고 0으로 채우는 함수입니다.
+    void write_page();
+
+    bag_file_writer(const bag_file_writer &);
+    bag_file_writer &operator=(const bag_file_writer &);
+};
+
+template <class Item>
+bag_file_writer<Item>::bag_file_writer()
+    : file(NULL), failed(false), page_count(0), item_count(0),
+      page(BAG_PAGE_SIZE / sizeof(uint64_t), 0), leaf_total(0) {}
+
+template <class Item> bag_file_writer<Item>::~bag_file_writer() {
+    if (file != NULL)
+        fclose(file);
+}
+
+template <class Item> bool bag_file_writer<Item>::open(const char *path) {
+    file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    write_page(); // 헤더는 finish()에서 다시 쓴다
+    header()->leaf = 1;
+    return !failed;
+}
+
+template <class Item>
+void bag_file_writer<Item>::add(const Item &entry, uint64_t mult) {
+    assert(file != NULL && mult > 0); // Precondition
+
+    bag_page_header *h = header();
+    uint64_t *counts = const_cast<uint64_t *>(layout::leaf_counts(&page[0]));
+    Item *keys = const_cast<Item *>(layout::leaf_keys(&page[0]));
+
+    // 리프는 다음 데이터가 들어올때 쓰므로 keys[h->count - 1]은 항상 바로
+    // 전에 추가한 데이터이다. 순서가 틀리면 검색할수 없는 파일이 되므로
+    // 추가하지 않고 실패로 기록한다
+    assert(h->count == 0 || !(entry < keys[h->count - 1])); // Precondition
+    if (h->count > 0 && entry < keys[h->count - 1]) {
+        failed = true;
+        return;
+    }
+
+    if (h->count > 0 && !(keys[h->count - 1] < entry)) {
+        // 같은 데이터가 이어서 들어오면 개수만 늘린다
+        counts[h->count - 1] += mult;
+    } else {
+        if (h->count == layout::LEAF_SLOTS) {
+            flush_leaf(false);
+            h = header();
+        }
+        if (h->count == 0) // 새 리프의 첫 데이터
+            first_keys.push_back(entry);
+        memcpy(&keys[h->count], &entry, sizeof(Item));
+        counts[h->count] = mult;
+        h->count++;
+    }
+    leaf_total += mult;
+    item_count += mult;
+}
+
+template <class Item> bool bag_file_writer<Item>::finish() {
+    assert(file != NULL); // Precondition
+
+    uint32_t height = 0;
+    if (header()->count > 0) {
+        flush_leaf(true);
+        height = 1;
+    }
+
+    // 아래 층의 페이지가 하나가 될때까지 FANOUT개씩 묶어 내부 페이지를 만든다
+    while (pages.size() > 1) {
+        std::vector<Item> up_keys;
+        std::vector<uint64_t> up_pages, up_totals;
+
+        for (size_t start = 0; start < pages.size(); start += layout::FANOUT) {
+            size_t n = pages.size() - start;
+            if (n > layout::FANOUT)
+                n = layout::FANOUT;
+
+            uint64_t *child =
+                const_cast<uint64_t *>(layout::children(&page[0]));
+            uint64_t *total = const_cast<uint64_t *>(layout::totals(&page[0]));
+            Item *keys = const_cast<Item *>(layout::internal_keys(&page[0]));
+            uint64_t sum = 0;
+            for (size_t j = 0; j < n; j++) {
+                child[j] = pages[start + j];
+                total[j] = totals[start + j];
+                sum += totals[start + j];
+                if (j > 0)
+                    memcpy(&keys[j - 1], &first_keys[start + j], sizeof(Item));
+            }
+            header()->leaf = 0;
+            header()->count = static_cast<uint32_t>(n);
+
+            up_keys.push_back(first_keys[start]);
+            up_pages.push_back(page_count);
+            up_totals.push_back(sum);
+            write_page();
+        }
+        first_keys.swap(up_keys);
+        pages.swap(up_pages);
+        totals.swap(up_totals);
+        height++;
+    }
+
+    // 헤더를 첫 페이지에 쓴다
+    bag_file_header *fh = reinterpret_cast<bag_file_header *>(&page[0]);
+    memcpy(fh->magic, "BAGFILE", 8);
+    fh->version = 1;
+    fh->byte_order = 0x01020304;
+    fh->page_size = BAG_PAGE_SIZE;
+    fh->item_size = sizeof(Item);
+    fh->height = height;
+    fh->item_count = item_count;
+    fh->page_count = page_count;
+    fh->root = pages.empty() ? 0 : pages[0];
+    fh->first_leaf = pages.empty() ? 0 : 1;
+    if (fseek(file, 0, SEEK_SET) != 0 ||
+        fwrite(&page[0], BAG_PAGE_SIZE, 1, file) != 1)
+        failed = true;
+
+    if (fclose(file) != 0)
+        failed = true;
+    file = NULL;
+    return !failed;
+}
+
+template <class Item> void bag_file_writer<Item>::flush_leaf(bool last) {
+    header()->leaf = 1;
+    header()->next = last ? 0 : page_count + 1;
+    pages.push_back(page_count);
+    totals.push_back(leaf_total);
+    leaf_total = 0;
+    write_page();
+    header()->leaf = 1;
+}
+
+template <class Item> void bag_file_writer<Item>::write_page() {
+    if (fwrite(&page[0], BAG_PAGE_SIZE, 1, file) != 1)
+        failed = true;
+    page_count++;
+    std::fill(page.begin(), page.end(), 0);
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef BAG_POOL_H
+#define BAG_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+/* bag_pool은 bag의 노드를 slab 단위로 할당하는 트리별 할당자입니다. 노드를
+ * 하나씩 new/delete 하지 않고 Alloc으로 받은 slab을 잘라서 사용하며, 반환된
+ * 노드는 free list에 넣어 재사용합니다. release()는 모든 slab을 한번에 해제하기
+ * 때문에 트리 전체를 노드 단위로 해제할 필요가 없습니다. */
+
+template <class Node, class Alloc> class bag_pool {
+  public:
+    // Constructor
+    explicit bag_pool(const Alloc &alloc = Alloc());
+
+    // Destructor
+    ~bag_pool();
+
+    // allocate()는 노드 하나를 저장할 메모리를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : 생성자가 호출되지 않은 Node 크기의 메모리를 반환.
+    Node *allocate();
+
+    // deallocate()는 allocate()로 받은 메모리를 pool에 반환하는 함수입니다.
+    // Pre : node는 이 pool에서 할당받았고 소멸자가 이미 호출되었다.
+    // Post : node의 메모리가 free list에 추가되어 다음 allocate()에서
+    //        재사용된다.
+    void deallocate(Node *node);
+
+    // adopt()는 other의 slab과 free list를 모두 가져오는 함수입니다. other에서
+    // 할당한 노드는 이후 이 pool의 노드가 되어 이 pool에 반환할수 있다.
+    // Pre : other의 allocator로 할당한 메모리를 이 pool의 allocator로 해제할수
+    //       있다.
+    // Post : other는 빈 pool이 된다.
+    void adopt(bag_pool &other);
+
+    // release()는 pool이 가진 모든 slab을 한번에 해제하는 함수입니다.
+    // Pre : pool에서 할당한 노드들의 소멸자가 모두 호출되었거나, 소멸자를
+    //       호출할 필요가 없다.
+    // Post : 모든 slab의 메모리가 Alloc으로 반환되고 pool은 비게 된다.
+    void release();
+
+    // capacity()는 pool이 가진 slab들에 들어가는 노드의 수를 반환하는
+    // 함수입니다.
+    // Pre : None.
+    // Post : 사용중인 노드와 비어있는 노드를 모두 센 수를 반환.
+    size_t capacity() const;
+
+  private:
+    // slab 하나의 크기는 처리량과 작은 트리의 메모리 낭비 사이에서 절충한다.
+    // 처음에는 FIRST_SLAB_NODES개로 시작해서 SLAB_BYTES를 넘지 않는 선에서
+    // 두배씩 늘린다.
+    static const size_t FIRST_SLAB_NODES = 4;
+    static const size_t SLAB_BYTES = 64 * 1024;
+    static const size_t MAX_SLAB_NODES =
+        (SLAB_BYTES / sizeof(Node) > FIRST_SLAB_NODES)
+            ? SLAB_BYTES / sizeof(Node)
+            : FIRST_SLAB_NODES;
+
+    struct slab {
+        slab *next;      // 이전에 할당한 slab
+        Node *nodes;     // slab의 노드 저장 공간
+        size_t capacity; // slab에 들어가는 노드의 수
+    };
+
+    // 반환된 노드의 메모리는 free list의 링크로 재사용한다. adopt()가 옮긴
+    // slab의 잘라쓰지 않은 부분은 노드를 하나씩 건드리지 않도록 첫 노드에
+    // 연속된 노드 수를 count로 적어 한 항목으로 넣는다.
+    struct free_node {
+        free_node *next;
+        size_t count; // 이 노드부터 연속으로 비어있는 노드의 수
+    };
+    static_assert(sizeof(Node) >= sizeof(free_node),
+                  "bag_pool needs nodes at least two pointers in size");
+
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Node>
+        node_allocator;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<slab>
+        slab_allocator;
+
+    node_allocator node_alloc;
+    slab_allocator slab_alloc;
+    slab *slabs;     // 가장 최근에 할당한 slab
+    slab *first;     // 가장 먼저 할당한 slab. slab 목록의 끝
+    size_t used;     // slabs에서 잘라서 사용한 노드의 수
+    free_node *free_list;
+    free_node *free_tail; // free_list의 마지막 노드. adopt()가 사용한다
+
+    bag_pool(const bag_pool &);
+    bag_pool &operator=(const bag_pool &);
+};
+
+template <class Node, class Alloc>
+bag_pool<Node, Alloc>::bag_pool(const Alloc &alloc)
+    : node_alloc(alloc), slab_alloc(alloc) {
+    slabs = NULL;
+    first = NULL;
+    used = 0;
+    free_list = NULL;
+    free_tail = NULL;
+}
+
+template <class Node, class Alloc> bag_pool<Node, Alloc>::~bag_pool() {
+    release();
+}
+
+template <class Node, class Alloc> Node *bag_pool<Node, Alloc>::allocate() {
+    if (free_list != NULL) {
+        // 반환된 노드가 있다면 먼저 재사용한다. 연속된 노드는 마지막 노드부터
+        // 사용한다.
+        free_node *reused = free_list;
+        if (reused->count > 1)
+            return reinterpret_cast<Node *>(reused) + --reused->count;
+        free_list = reused->next;
+        return reinterpret_cast<Node *>(reused);
+    }
+
+    if (slabs == NULL || used == slabs->capacity) {
+        // 현재 slab을 모두 사용했다면 더 큰 slab을 새로 할당한다
+        size_t capacity = FIRST_SLAB_NODES;
+        if (slabs != NULL && slabs->capacity < MAX_SLAB_NODES)
+            capacity = 2 * slabs->capacity;
+        else if (slabs != NULL)
+            capacity = MAX_SLAB_NODES;
+
+        slab *new_slab = std::allocator_traits<slab_allocator>::allocate(
+            slab_alloc, 1);
+        new_slab->nodes =
+            std::allocator_traits<node_allocator>::allocate(node_alloc,
+                                                            capacity);
+        new_slab->capacity = capacity;
+        new_slab->next = slabs;
+        if (slabs == NULL)
+            first = new_slab;
+        slabs = new_slab;
+        used = 0;
+    }
+
+    return slabs->nodes + used++;
+}
+
+template <class Node, class Alloc>
+void bag_pool<Node, Alloc>::deallocate(Node *node) {
+    assert(node != NULL); // Precondition
+
+    free_node *freed = reinterpret_cast<free_node *>(node);
+    if (free_list == NULL)
+        free_tail = freed;
+    freed->next = free_list;
+    freed->count = 1;
+    free_list = freed;
+}
+
+template <class Node, class Alloc>
+void bag_pool<Node, Alloc>::adopt(bag_pool &other) {
+    if (other.slabs == NULL)
+        return;
+
+    // other의 현재 slab에서 아직 잘라쓰지 않은 노드는 한 항목으로 free
+    // list에 넣는다. 노드마다 링크를 쓰면 아직 건드리지 않은 메모리 페이지를
+    // 모두 건드리게 된다.
+    if (other.used < other.slabs->capacity) {
+        other.deallocate(other.slabs->nodes + other.used);
+        other.free_list->count = other.slabs->capacity - other.used;
+    }
+
+    // other의 slab들은 현재 slab 뒤에 이어서 현재 slab을 계속 잘라쓴다. 두
+    // 목록의 끝을 기억하고 있으므로 slab 수와 상관없이 O(1)에 잇는다.
+    if (slabs == NULL) {
+        slabs = other.slabs;
+        first = other.first;
+        used = slabs->capacity;
+    } else {
+        other.first->next = slabs->next;
+        if (first == slabs)
+            first = other.first;
+        slabs->next = other.slabs;
+    }
+
+    if (other.free_list != NULL) {
+        other.free_tail->next = free_list;
+        if (free_list == NULL)
+            free_tail = other.free_tail;
+        free_list = other.free_list;
+    }
+
+    other.slabs = NULL;
+    other.first = NULL;
+    other.used = 0;
+    other.free_list = NULL;
+    other.free_tail = NULL;
+}
+
+template <class Node, class Alloc> void bag_pool<Node, Alloc>::release() {
+    while (slabs != NULL) {
+        slab *next = slabs->next;
+        std::allocator_traits<node_allocator>::deallocate(
+            node_alloc, slabs->nodes, slabs->capacity);
+        std::allocator_traits<slab_allocator>::deallocate(slab_alloc, slabs,
+                                                          1);
+        slabs = next;
+    }
+    first = NULL;
+    used = 0;
+    free_list = NULL;
+    free_tail = NULL;
+}
+
+template <class Node, class Alloc>
+size_t bag_pool<Node, Alloc>::capacity() const {
+    size_t total = 0;
+    for (const slab *s = slabs; s != NULL; s = s->next)
+        total += s->capacity;
+    return total;
+}
+
+#endif
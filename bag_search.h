@@ -0,0 +1,374 @@
+#ifndef BAG_SEARCH_H
+#define BAG_SEARCH_H
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* bag_search는 bag의 노드 하나 안에서 target이 들어갈 위치를 찾는 검색
+ * 커널입니다. 노드의 data[]는 정렬되어 있으므로 다음 두 값을 구합니다.
+ *
+ *   lower_bound : data[i] < target 인 데이터의 수 (target의 첫 위치)
+ *   upper_bound : data[i] <= target 인 데이터의 수 (target의 다음 위치)
+ *
+ * 정수와 실수 타입은 노드의 데이터를 SSE2(컴파일러가 __AVX2__를 정의하면
+ * AVX2)로 한번에 비교한 후 비교 결과의 비트 수를 세어 위치를 구합니다. 그 외의
+ * 타입이나 std::less가 아닌 비교자는 비교자만 사용하는 branchless 이진 검색을
+ * 사용합니다. 어떤 커널을 쓸지는 컴파일 타임에 Item과 비교자의 타입으로
+ * 결정됩니다.
+ *
+ * std::string은 노드가 각 데이터의 앞 8바이트를 정수(prefix key)로 함께
+ * 저장하면 bag_prefix_search로 찾을수 있습니다. 대부분의 비교가 노드 안의
+ * 정수 비교로 끝나므로 문자열의 힙 메모리를 읽지 않습니다. */
+
+// bag_scalar_search는 비교자 Compare만 사용하는 일반적인 검색 커널입니다.
+// Compare가 transparent 비교자라면 target은 Item이 아닌 타입이어도 된다.
+template <class Item, class Compare = std::less<Item>>
+struct bag_scalar_search {
+    // lower_bound()는 data[0..n)에서 target보다 작은 데이터의 수를 반환하는
+    // 함수입니다.
+    // Pre : data[0..n)은 less의 오름차순으로 정렬되어 있다.
+    // Post : less(data[i], target) 인 i의 개수를 반환.
+    template <class Key>
+    static size_t lower_bound(const Item *data, size_t n, const Key &target,
+                              const Compare &less = Compare());
+
+    // upper_bound()는 data[0..n)에서 target보다 작거나 같은 데이터의 수를
+    // 반환하는 함수입니다.
+    // Pre : data[0..n)은 less의 오름차순으로 정렬되어 있다.
+    // Post : !less(target, data[i]) 인 i의 개수를 반환.
+    template <class Key>
+    static size_t upper_bound(const Item *data, size_t n, const Key &target,
+                              const Compare &less = Compare());
+};
+
+template <class Item, class Compare>
+template <class Key>
+size_t bag_scalar_search<Item, Compare>::lower_bound(const Item *data,
+                                                     size_t n,
+                                                     const Key &target,
+                                                     const Compare &less) {
+    if (n == 0)
+        return 0;
+
+    // 구간의 길이를 반씩 줄이면서 시작 위치만 조건부로 옮긴다. 분기 대신
+    // 조건부 이동으로 컴파일되므로 분기 예측 실패가 없다.
+    const Item *base = data;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = less(base[half - 1], target) ? base + half : base;
+        n -= half;
+    }
+    return (base - data) + (less(*base, target) ? 1 : 0);
+}
+
+template <class Item, class Compare>
+template <class Key>
+size_t bag_scalar_search<Item, Compare>::upper_bound(const Item *data,
+                                                     size_t n,
+                                                     const Key &target,
+                                                     const Compare &less) {
+    if (n == 0)
+        return 0;
+
+    const Item *base = data;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = !less(target, base[half - 1]) ? base + half : base;
+        n -= half;
+    }
+    return (base - data) + (!less(target, *base) ? 1 : 0);
+}
+
+// bag_simd_search는 정수와 실수 타입을 위한 검색 커널입니다. 노드의 모든
+// 데이터를 target과 비교해서 target보다 작은(또는 큰) 데이터의 수를 센다.
+// 노드가 정렬되어 있으므로 그 수가 곧 검색 결과의 위치가 된다. 비교자는
+// 항상 std::less이므로 받기만 하고 사용하지 않는다.
+template <class Item> struct bag_simd_search {
+    template <class Compare = std::less<Item>>
+    static size_t lower_bound(const Item *data, size_t n, const Item &target,
+                              const Compare & = Compare());
+    template <class Compare = std::less<Item>>
+    static size_t upper_bound(const Item *data, size_t n, const Item &target,
+                              const Compare & = Compare());
+
+  private:
+    // count_less()는 data[0..n)에서 target보다 작은 데이터의 수를,
+    // count_greater()는 target보다 큰 데이터의 수를 반환하는 함수입니다.
+    static size_t count_less(const Item *data, size_t n, Item target);
+    static size_t count_greater(const Item *data, size_t n, Item target);
+
+#if defined(__SSE2__)
+    // simd_count()는 벡터 레지스터 단위로 비교할수 있는 앞부분만 비교하고
+    // 비교한 데이터의 수를 done에 저장하는 함수입니다. GREATER가 true이면
+    // target보다 큰 데이터를, false이면 작은 데이터를 센다.
+    template <bool GREATER>
+    static size_t simd_count(const Item *data, size_t n, Item target,
+                             size_t &done);
+#endif
+};
+
+template <class Item>
+template <class Compare>
+size_t bag_simd_search<Item>::lower_bound(const Item *data, size_t n,
+                                          const Item &target,
+                                          const Compare &) {
+    return count_less(data, n, target);
+}
+
+template <class Item>
+template <class Compare>
+size_t bag_simd_search<Item>::upper_bound(const Item *data, size_t n,
+                                          const Item &target,
+                                          const Compare &) {
+    return n - count_greater(data, n, target);
+}
+
+template <class Item>
+size_t bag_simd_search<Item>::count_less(const Item *data, size_t n,
+                                         Item target) {
+    size_t done = 0;
+    size_t count = 0;
+#if defined(__SSE2__)
+    count = simd_count<false>(data, n, target, done);
+#endif
+    // 벡터 하나를 채우지 못하는 나머지 데이터는 하나씩 비교한다
+    for (; done < n; done++)
+        count += (data[done] < target) ? 1 : 0;
+    return count;
+}
+
+template <class Item>
+size_t bag_simd_search<Item>::count_greater(const Item *data, size_t n,
+                                            Item target) {
+    size_t done = 0;
+    size_t count = 0;
+#if defined(__SSE2__)
+    count = simd_count<true>(data, n, target, done);
+#endif
+    for (; done < n; done++)
+        count += (target < data[done]) ? 1 : 0;
+    return count;
+}
+
+#if defined(__SSE2__)
+template <class Item>
+template <bool GREATER>
+size_t bag_simd_search<Item>::simd_count(const Item *data, size_t n,
+                                         Item target, size_t &done) {
+    size_t count = 0;
+    done = 0;
+
+    if (std::is_floating_point<Item>::value && sizeof(Item) == 4) {
+        const float *keys = reinterpret_cast<const float *>(data);
+        float t = static_cast<float>(target);
+#if defined(__AVX2__)
+        __m256 t8 = _mm256_set1_ps(t);
+        for (; done + 8 <= n; done += 8) {
+            __m256 k = _mm256_loadu_ps(keys + done);
+            __m256 m = GREATER ? _mm256_cmp_ps(k, t8, _CMP_GT_OQ)
+                               : _mm256_cmp_ps(k, t8, _CMP_LT_OQ);
+            count += __builtin_popcount(_mm256_movemask_ps(m));
+        }
+#endif
+        __m128 t4 = _mm_set1_ps(t);
+        for (; done + 4 <= n; done += 4) {
+            __m128 k = _mm_loadu_ps(keys + done);
+            __m128 m = GREATER ? _mm_cmpgt_ps(k, t4) : _mm_cmplt_ps(k, t4);
+            count += __builtin_popcount(_mm_movemask_ps(m));
+        }
+    } else if (std::is_floating_point<Item>::value && sizeof(Item) == 8) {
+        const double *keys = reinterpret_cast<const double *>(data);
+        double t = static_cast<double>(target);
+#if defined(__AVX2__)
+        __m256d t4 = _mm256_set1_pd(t);
+        for (; done + 4 <= n; done += 4) {
+            __m256d k = _mm256_loadu_pd(keys + done);
+            __m256d m = GREATER ? _mm256_cmp_pd(k, t4, _CMP_GT_OQ)
+                                : _mm256_cmp_pd(k, t4, _CMP_LT_OQ);
+            count += __builtin_popcount(_mm256_movemask_pd(m));
+        }
+#endif
+        __m128d t2 = _mm_set1_pd(t);
+        for (; done + 2 <= n; done += 2) {
+            __m128d k = _mm_loadu_pd(keys + done);
+            __m128d m = GREATER ? _mm_cmpgt_pd(k, t2) : _mm_cmplt_pd(k, t2);
+            count += __builtin_popcount(_mm_movemask_pd(m));
+        }
+    } else if (std::is_integral<Item>::value && sizeof(Item) <= 4) {
+        // SSE2의 정수 비교는 부호 있는 비교만 있으므로 부호 없는 타입은
+        // 부호 비트를 뒤집어서 비교한다. movemask_epi8은 바이트마다 비트를
+        // 하나씩 만들기 때문에 센 비트 수를 sizeof(Item)으로 나눈다.
+        const size_t LANES = 16 / sizeof(Item);
+        const bool flip = !std::is_signed<Item>::value;
+        __m128i t, bias;
+        if (sizeof(Item) == 1) {
+            bias = _mm_set1_epi8(flip ? (char)0x80 : 0);
+            t = _mm_xor_si128(_mm_set1_epi8((char)target), bias);
+        } else if (sizeof(Item) == 2) {
+            bias = _mm_set1_epi16(flip ? (short)0x8000 : 0);
+            t = _mm_xor_si128(_mm_set1_epi16((short)target), bias);
+        } else {
+            bias = _mm_set1_epi32(flip ? (int)0x80000000u : 0);
+            t = _mm_xor_si128(_mm_set1_epi32((int)target), bias);
+        }
+
+        for (; done + LANES <= n; done += LANES) {
+            __m128i k = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + done)),
+                bias);
+            __m128i m;
+            if (sizeof(Item) == 1)
+                m = GREATER ? _mm_cmpgt_epi8(k, t) : _mm_cmplt_epi8(k, t);
+            else if (sizeof(Item) == 2)
+                m = GREATER ? _mm_cmpgt_epi16(k, t) : _mm_cmplt_epi16(k, t);
+            else
+                m = GREATER ? _mm_cmpgt_epi32(k, t) : _mm_cmplt_epi32(k, t);
+            count += __builtin_popcount(_mm_movemask_epi8(m)) / sizeof(Item);
+        }
+    }
+#if defined(__SSE4_2__) || defined(__AVX2__)
+    else if (std::is_integral<Item>::value && sizeof(Item) == 8) {
+        // 64비트 정수 비교는 SSE4.2부터 지원된다
+        const bool flip = !std::is_signed<Item>::value;
+        __m128i bias = _mm_set1_epi64x(flip ? (long long)0x8000000000000000ull
+                                            : 0);
+        __m128i t = _mm_xor_si128(_mm_set1_epi64x((long long)target), bias);
+        for (; done + 2 <= n; done += 2) {
+            __m128i k = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + done)),
+                bias);
+            __m128i m = GREATER ? _mm_cmpgt_epi64(k, t) : _mm_cmpgt_epi64(t, k);
+            count += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(m)));
+        }
+    }
+#endif
+
+    return count;
+}
+#endif
+
+// bag_search_traits는 Item과 Compare에 맞는 검색 커널을 선택합니다. 정수와
+// 실수 타입(bool 제외)을 std::less로 비교하면 bag_simd_search를, 그 외에는
+// bag_scalar_search를 사용합니다.
+template <class Item, class Compare = std::less<Item>, class Enable = void>
+struct bag_search_traits {
+    typedef bag_scalar_search<Item, Compare> type;
+};
+
+template <class Item, class Compare>
+struct bag_search_traits<
+    Item, Compare,
+    typename std::enable_if<
+        std::is_arithmetic<Item>::value && !std::is_same<Item, bool>::value &&
+        (std::is_same<Compare, std::less<Item>>::value ||
+         std::is_same<Compare, std::less<>>::value)>::type> {
+    typedef bag_simd_search<Item> type;
+};
+
+// bag_prefix_traits는 노드에 prefix key를 함께 저장할수 있는지 정합니다.
+// 데이터가 std::string이고 바이트 순서로 비교할때만 prefix key의 순서가
+// 문자열의 순서와 같다.
+template <class Item, class Compare> struct bag_prefix_traits {
+    static const bool value = false;
+};
+
+template <> struct bag_prefix_traits<std::string, std::less<std::string>> {
+    static const bool value = true;
+};
+
+template <> struct bag_prefix_traits<std::string, std::less<>> {
+    static const bool value = true;
+};
+
+// bag_prefix_key() 함수는 s[skip..]의 앞 8바이트를 big-endian 정수로 만드는
+// 함수입니다. 8바이트보다 짧으면 뒤를 0으로 채웁니다. 바이트를 부호 없는
+// 수로 비교하므로 두 문자열의 prefix key가 다르면 그 순서가 문자열의 순서와
+// 같습니다. 같다면 문자열을 직접 비교해야 합니다.
+// Pre : None.
+// Post : s[skip..skip+8)의 prefix key를 반환. skip이 s보다 길면 0 반환.
+inline uint64_t bag_prefix_key(std::string_view s, size_t skip) {
+    uint64_t key = 0;
+    size_t length = s.size() > skip ? s.size() - skip : 0;
+    if (length >= 8) {
+        std::memcpy(&key, s.data() + skip, 8);
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return __builtin_bswap64(key);
+#else
+        key = 0;
+        length = 8;
+#endif
+    }
+    for (size_t i = 0; i < 8; i++) {
+        key <<= 8;
+        if (i < length)
+            key |= static_cast<unsigned char>(s[skip + i]);
+    }
+    return key;
+}
+
+// bag_prefix_search는 prefix key를 가진 노드에서 문자열의 위치를 찾는 검색
+// 커널입니다. keys[i]는 data[i]의 prefix key이고, key는 target의 prefix
+// key이다. prefix key가 같은 데이터만 문자열을 직접 비교한다.
+struct bag_prefix_search {
+    // lower_bound()는 data[0..n)에서 target보다 작은 데이터의 수를 반환하는
+    // 함수입니다.
+    // Pre : data[0..n)은 오름차순이고 keys[i]는 data[i]의 prefix key이다.
+    // Post : data[i] < target 인 i의 개수를 반환.
+    static size_t lower_bound(const uint64_t *keys, const std::string *data,
+                              size_t n, std::string_view target,
+                              uint64_t key);
+
+    // upper_bound()는 data[0..n)에서 target보다 작거나 같은 데이터의 수를
+    // 반환하는 함수입니다.
+    // Pre : data[0..n)은 오름차순이고 keys[i]는 data[i]의 prefix key이다.
+    // Post : !(target < data[i]) 인 i의 개수를 반환.
+    static size_t upper_bound(const uint64_t *keys, const std::string *data,
+                              size_t n, std::string_view target,
+                              uint64_t key);
+};
+
+inline size_t bag_prefix_search::lower_bound(const uint64_t *keys,
+                                             const std::string *data,
+                                             size_t n,
+                                             std::string_view target,
+                                             uint64_t key) {
+    size_t base = 0;
+    while (n > 0) {
+        size_t half = n / 2;
+        size_t i = base + half;
+        bool less = keys[i] < key ||
+                    (keys[i] == key && std::string_view(data[i]) < target);
+        base = less ? i + 1 : base;
+        n = less ? n - half - 1 : half;
+    }
+    return base;
+}
+
+inline size_t bag_prefix_search::upper_bound(const uint64_t *keys,
+                                             const std::string *data,
+                                             size_t n,
+                                             std::string_view target,
+                                             uint64_t key) {
+    size_t base = 0;
+    while (n > 0) {
+        size_t half = n / 2;
+        size_t i = base + half;
+        bool not_greater =
+            keys[i] < key ||
+            (keys[i] == key && !(target < std::string_view(data[i])));
+        base = not_greater ? i + 1 : base;
+        n = not_greater ? n - half - 1 : half;
+    }
+    return base;
+}
+
+#endif
@@ -0,0 +1,388 @@
+/* bag과 std::multiset의 단일 스레드 벤치마크입니다.
+ *
+ *   cmake -S bench -B build && cmake --build build --target bag_bench
+ *   build/bag_bench [옵션]
+ *
+ *   --sizes 1000,1000000    측정할 데이터 수 (기본: 1K부터 100M까지 10배씩)
+ *   --dists uniform,zipf    키 분포. uniform, zipf, sorted, duplicates
+ *   --ops N                 count, count_batch, erase_one, mix에서 수행할 연산
+ *                           수 (기본 1M)
+ *   --baseline-max N        std::multiset을 측정할 최대 데이터 수 (기본 10M)
+ *   --format csv|json       출력 형식 (기본 csv)
+ *   --label TEXT            결과의 모든 행에 붙일 이름. 버전 비교에 사용
+ *
+ * 각 (컨테이너, 분포, 데이터 수)마다 다음을 측정합니다.
+ *
+ *   insert     빈 컨테이너에 n개의 키를 분포의 순서대로 삽입
+ *   count      분포에서 뽑은 키 ops개의 count()
+ *   count_batch  같은 키 ops개를 count_batch() 한번으로 검색 (bag만)
+ *   copy       복사 생성자 한번 (bag은 노드를 공유하므로 O(1))
+ *   erase_one  삽입한 키 중 ops개를 임의의 순서로 erase_one()
+ *   mix        count 70%, insert 15%, erase_one 15%를 섞은 ops개의 연산
+ *
+ * 결과는 한 측정이 한 행인 CSV나 JSON으로 표준 출력에 씁니다. 진행 상황은
+ * 표준 에러로 출력합니다. */
+
+#include "../bag.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// options는 명령행 인자로 정하는 벤치마크 설정입니다.
+struct options {
+    vector<size_t> sizes;
+    vector<string> dists;
+    size_t ops;
+    size_t baseline_max;
+    bool json;
+    string label;
+};
+
+// result는 측정 하나의 결과입니다.
+struct result {
+    string container;
+    size_t fanout; // 노드의 최대 데이터 수. multiset은 0
+    string dist;
+    size_t size;
+    string operation;
+    size_t ops;
+    double total_ms;
+};
+
+// 측정한 연산의 결과를 모아서 연산이 최적화로 사라지지 않게 한다
+static volatile size_t sink;
+
+static double elapsed_ms(chrono::steady_clock::time_point start) {
+    chrono::duration<double, milli> d = chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+// zipf_generator는 [0, n)에서 순위 r의 확률이 1 / (r + 1)^theta에 비례하는
+// 순위를 만드는 클래스입니다. Gray et al.의 근사 방법을 사용하므로 생성자만
+// O(n)이고 뽑기는 O(1)입니다. 인기 있는 순위가 트리의 한쪽에 모이지 않도록
+// [0, n)을 섞은 순열로 순위를 키에 대응시킵니다. 순열은 고정된 seed로 섞으므로
+// 같은 n이면 삽입할 키와 검색할 키의 인기 있는 키가 같습니다.
+class zipf_generator {
+  public:
+    zipf_generator(size_t n, double theta)
+        : n(n), theta(theta), keys(n) {
+        for (size_t i = 0; i < n; i++)
+            keys[i] = uint32_t(i);
+        mt19937_64 rng(0x5eed);
+        shuffle(keys.begin(), keys.end(), rng);
+
+        double zeta2 = 1 + pow(0.5, theta);
+        zetan = 0;
+        for (size_t i = 1; i <= n; i++)
+            zetan += 1 / pow(double(i), theta);
+        alpha = 1 / (1 - theta);
+        eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    size_t operator()(mt19937_64 &rng) {
+        double u = uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan;
+        size_t rank;
+        if (uz < 1)
+            rank = 0;
+        else if (uz < 1 + pow(0.5, theta))
+            rank = 1;
+        else
+            rank = size_t(n * pow(eta * u - eta + 1, alpha));
+        if (rank >= n)
+            rank = n - 1;
+        return keys[rank];
+    }
+
+  private:
+    size_t n;
+    double theta, zetan, alpha, eta;
+    vector<uint32_t> keys; // 순위 r의 키. 키는 int이므로 4바이트면 충분하다
+};
+
+// make_keys()는 분포 dist를 따르는 키 count개를 만드는 함수입니다. n은
+// 컨테이너의 데이터 수로, 키의 범위를 정합니다.
+static vector<int> make_keys(const string &dist, size_t n, size_t count,
+                             uint64_t seed) {
+    mt19937_64 rng(seed);
+    vector<int> keys(count);
+
+    if (dist == "uniform" || dist == "sorted") {
+        uniform_int_distribution<int> pick(0, int(n - 1));
+        for (size_t i = 0; i < count; i++)
+            keys[i] = pick(rng);
+        if (dist == "sorted")
+            sort(keys.begin(), keys.end());
+    } else if (dist == "zipf") {
+        zipf_generator pick(n, 0.99);
+        for (size_t i = 0; i < count; i++)
+            keys[i] = int(pick(rng));
+    } else if (dist == "duplicates") {
+        // 키 하나가 평균 1000번씩 반복된다
+        size_t distinct = n / 1000 > 0 ? n / 1000 : 1;
+        uniform_int_distribution<int> pick(0, int(distinct - 1));
+        for (size_t i = 0; i < count; i++)
+            keys[i] = pick(rng);
+    } else {
+        fprintf(stderr, "unknown distribution: %s\n", dist.c_str());
+        exit(1);
+    }
+    return keys;
+}
+
+// erase_one()은 컨테이너에서 target 하나를 지우는 함수입니다. multiset에는
+// erase_one()이 없으므로 find()한 위치를 지운다.
+template <class Bag> static bool erase_one(Bag &b, int target) {
+    return b.erase_one(target);
+}
+
+static bool erase_one(multiset<int> &m, int target) {
+    multiset<int>::iterator it = m.find(target);
+    if (it == m.end())
+        return false;
+    m.erase(it);
+    return true;
+}
+
+// count_batch()는 probes의 개수를 한번에 세는 함수입니다. multiset에는 batch
+// 검색이 없으므로 false를 반환하고 측정하지 않는다.
+template <class Bag>
+static bool count_batch(const Bag &b, const vector<int> &probes,
+                        vector<size_t> &counts) {
+    b.count_batch(probes.data(), probes.size(), counts.data());
+    return true;
+}
+
+static bool count_batch(const multiset<int> &, const vector<int> &,
+                        vector<size_t> &) {
+    return false;
+}
+
+// run_container()는 컨테이너 C 하나에 대해 모든 연산을 측정하는 함수입니다.
+// inserted는 삽입할 키, probes는 count와 mix에서 사용할 키이다.
+template <class C>
+static void run_container(const string &name, size_t fanout,
+                          const string &dist, const vector<int> &inserted,
+                          const vector<int> &probes, vector<result> &results) {
+    size_t n = inserted.size();
+    size_t ops = probes.size();
+    result r = {name, fanout, dist, n, "", 0, 0};
+
+    C c;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+        c.insert(inserted[i]);
+    r.operation = "insert";
+    r.ops = n;
+    r.total_ms = elapsed_ms(start);
+    results.push_back(r);
+
+    size_t found = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; i++)
+        found += c.count(probes[i]);
+    r.operation = "count";
+    r.ops = ops;
+    r.total_ms = elapsed_ms(start);
+    results.push_back(r);
+
+    vector<size_t> counts(ops);
+    start = chrono::steady_clock::now();
+    if (count_batch(c, probes, counts)) {
+        r.operation = "count_batch";
+        r.ops = ops;
+        r.total_ms = elapsed_ms(start);
+        results.push_back(r);
+        for (size_t i = 0; i < ops; i++)
+            found += counts[i];
+    }
+
+    {
+        start = chrono::steady_clock::now();
+        C copy(c);
+        r.operation = "copy";
+        r.ops = 1;
+        r.total_ms = elapsed_ms(start);
+        results.push_back(r);
+        found += copy.size();
+    }
+
+    // 삽입한 키 중 ops개를 골라 임의의 순서로 지운다
+    vector<int> victims(inserted.begin(),
+                        inserted.begin() + (ops < n ? ops : n));
+    shuffle(victims.begin(), victims.end(), mt19937_64(n));
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < victims.size(); i++)
+        found += erase_one(c, victims[i]);
+    r.operation = "erase_one";
+    r.ops = victims.size();
+    r.total_ms = elapsed_ms(start);
+    results.push_back(r);
+
+    // 지운 만큼 다시 채운 후 연산을 섞는다
+    for (size_t i = 0; i < victims.size(); i++)
+        c.insert(victims[i]);
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; i++) {
+        size_t dice = (i * 0x9E3779B9u) % 100;
+        if (dice < 70)
+            found += c.count(probes[i]);
+        else if (dice < 85)
+            c.insert(probes[i]);
+        else
+            found += erase_one(c, probes[i]);
+    }
+    r.operation = "mix";
+    r.ops = ops;
+    r.total_ms = elapsed_ms(start);
+    results.push_back(r);
+
+    sink += found;
+    fprintf(stderr, "  %-22s %-10s %10zu done\n", name.c_str(), dist.c_str(),
+            n);
+}
+
+// fanout_bag()은 MINIMUM별 bag을 측정하는 함수입니다.
+template <size_t MINIMUM>
+static void fanout_bag(const string &dist, const vector<int> &inserted,
+                       const vector<int> &probes, vector<result> &results) {
+    char name[32];
+    snprintf(name, sizeof(name), "bag<int,%zu>", MINIMUM);
+    run_container<bag<int, MINIMUM> >(name, 2 * MINIMUM, dist, inserted,
+                                      probes, results);
+}
+
+static void run_size(const options &opt, const string &dist, size_t n,
+                     vector<result> &results) {
+    vector<int> inserted = make_keys(dist, n, n, 1);
+    size_t ops = opt.ops < n ? opt.ops : n;
+    // sorted 분포에서도 검색할 키는 임의의 순서로 뽑는다
+    vector<int> probes =
+        make_keys(dist == "sorted" ? "uniform" : dist, n, ops, 2);
+
+    const size_t DEFAULT_MINIMUM = bag_default_minimum<int>::value;
+    if (n <= opt.baseline_max)
+        run_container<multiset<int> >("std::multiset", 0, dist, inserted,
+                                      probes, results);
+    fanout_bag<2>(dist, inserted, probes, results);
+    fanout_bag<8>(dist, inserted, probes, results);
+    fanout_bag<DEFAULT_MINIMUM>(dist, inserted, probes, results);
+    fanout_bag<64>(dist, inserted, probes, results);
+    run_container<run_length_bag<int> >("run_length_bag<int>",
+                                        2 * DEFAULT_MINIMUM, dist, inserted,
+                                        probes, results);
+    run_container<order_statistic_bag<int> >("order_statistic_bag<int>",
+                                             2 * DEFAULT_MINIMUM, dist,
+                                             inserted, probes, results);
+}
+
+static void print_csv(const options &opt, const vector<result> &results) {
+    printf("label,container,fanout,distribution,size,operation,ops,total_ms,"
+           "ns_per_op\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const result &r = results[i];
+        printf("%s,\"%s\",%zu,%s,%zu,%s,%zu,%.3f,%.2f\n", opt.label.c_str(),
+               r.container.c_str(), r.fanout, r.dist.c_str(), r.size,
+               r.operation.c_str(), r.ops, r.total_ms,
+               r.total_ms * 1e6 / r.ops);
+    }
+}
+
+static void print_json(const options &opt, const vector<result> &results) {
+    printf("{\n  \"label\": \"%s\",\n  \"results\": [\n", opt.label.c_str());
+    for (size_t i = 0; i < results.size(); i++) {
+        const result &r = results[i];
+        printf("    {\"container\": \"%s\", \"fanout\": %zu, "
+               "\"distribution\": \"%s\", \"size\": %zu, "
+               "\"operation\": \"%s\", \"ops\": %zu, \"total_ms\": %.3f, "
+               "\"ns_per_op\": %.2f}%s\n",
+               r.container.c_str(), r.fanout, r.dist.c_str(), r.size,
+               r.operation.c_str(), r.ops, r.total_ms,
+               r.total_ms * 1e6 / r.ops, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// split()은 쉼표로 나뉜 목록을 나누는 함수입니다.
+static vector<string> split(const char *list) {
+    vector<string> items;
+    string item;
+    for (const char *p = list;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty())
+                items.push_back(item);
+            item.clear();
+            if (*p == '\0')
+                break;
+        } else {
+            item += *p;
+        }
+    }
+    return items;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: bag_bench [--sizes N,...] [--dists D,...] "
+                    "[--ops N] [--baseline-max N] [--format csv|json] "
+                    "[--label TEXT]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    options opt;
+    for (size_t n = 1000; n <= 100000000; n *= 10)
+        opt.sizes.push_back(n);
+    opt.dists = split("uniform,zipf,sorted,duplicates");
+    opt.ops = 1000000;
+    opt.baseline_max = 10000000;
+    opt.json = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            usage();
+        const char *value = argv[i + 1];
+        if (strcmp(argv[i], "--sizes") == 0) {
+            vector<string> sizes = split(value);
+            opt.sizes.clear();
+            for (size_t j = 0; j < sizes.size(); j++)
+                opt.sizes.push_back(strtoull(sizes[j].c_str(), NULL, 10));
+        } else if (strcmp(argv[i], "--dists") == 0) {
+            opt.dists = split(value);
+        } else if (strcmp(argv[i], "--ops") == 0) {
+            opt.ops = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--baseline-max") == 0) {
+            opt.baseline_max = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--format") == 0) {
+            opt.json = strcmp(value, "json") == 0;
+        } else if (strcmp(argv[i], "--label") == 0) {
+            opt.label = value;
+        } else {
+            usage();
+        }
+        i++;
+    }
+
+    vector<result> results;
+    for (size_t d = 0; d < opt.dists.size(); d++) {
+        for (size_t s = 0; s < opt.sizes.size(); s++) {
+            if (opt.sizes[s] == 0)
+                continue;
+            run_size(opt, opt.dists[d], opt.sizes[s], results);
+        }
+    }
+
+    if (opt.json)
+        print_json(opt, results);
+    else
+        print_csv(opt, results);
+    return 0;
+}
@@ -0,0 +1,170 @@
+/* buffered_bag과 bag의 삽입 위주 작업 벤치마크입니다.
+ *
+ *   g++ -std=c++17 -O2 -I.. buffered_bench.cpp -o buffered_bench
+ *   ./buffered_bench [연산 수] [키 범위]
+ *
+ * 먼저 작은 노드의 buffered_bag이 무작위 삽입, 삭제 후에도 bag과 같은 개수를
+ * 반환하는지 검사합니다. 그 다음 세가지 키 분포(uniform, 키 범위가 좁아 중복이
+ * 많은 duplicates, 오름차순인 sorted)에서 삽입만 하는 경우와 95%가 삽입이고
+ * 나머지가 count()인 경우의 연산당 시간, 그리고 삽입이 끝난 후의 count() 시간을
+ * 비교합니다. */
+
+#include "../bag.h"
+#include "../buffered_bag.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// workload는 벤치마크 하나의 키 분포입니다.
+struct workload {
+    const char *name;
+    vector<int> keys;   // 차례로 넣을 키
+    vector<int> probes; // 삽입후 count()할 키
+};
+
+// result는 컨테이너 하나의 연산당 시간(ns)입니다.
+struct result {
+    double insert; // 삽입만 할때
+    double mixed;  // 95% 삽입, 5% count()
+    double count;  // 삽입이 끝난 후의 count()
+};
+
+static void fail(const char *message) {
+    printf("check failed: %s\n", message);
+    exit(1);
+}
+
+// check()는 buffered_bag과 bag에 같은 연산을 하면서 개수를 비교하는
+// 함수입니다. 노드가 작으므로 buffer를 내려보내고 노드를 나누는 경우가 자주
+// 일어납니다.
+static void check(size_t ops, int keys) {
+    buffered_bag<int, 4, 8> b;
+    bag<int> expected;
+    mt19937 rng(7);
+
+    for (size_t i = 0; i < ops; i++) {
+        int key = rng() % keys;
+        size_t dice = rng() % 10;
+        if (dice < 6) {
+            b.insert(key);
+            expected.insert(key);
+        } else if (dice < 8) {
+            if (b.erase_one(key) != expected.erase_one(key))
+                fail("erase_one");
+        } else if (dice < 9) {
+            if (b.erase_all(key) != expected.erase_all(key))
+                fail("erase_all");
+        } else if (b.count(key) != expected.count(key)) {
+            fail("count");
+        }
+        if (i % 4096 == 0)
+            b.flush();
+    }
+    if (b.size() != expected.size())
+        fail("size");
+    b.flush();
+    for (int key = 0; key < keys; key++)
+        if (b.count(key) != expected.count(key))
+            fail("count after flush");
+}
+
+static double nanoseconds_per(chrono::steady_clock::time_point start,
+                              size_t ops) {
+    chrono::duration<double, nano> elapsed =
+        chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+// run()은 Bag에 w의 키를 넣으면서 연산당 시간을 재는 함수입니다.
+template <class Bag> static result run(const workload &w) {
+    result r;
+    size_t found = 0;
+
+    {
+        Bag b;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < w.keys.size(); i++)
+            b.insert(w.keys[i]);
+        r.insert = nanoseconds_per(start, w.keys.size());
+
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < w.probes.size(); i++)
+            found += b.count(w.probes[i]);
+        r.count = nanoseconds_per(start, w.probes.size());
+    }
+
+    {
+        // 20번째 연산마다 앞에서 넣은 키를 검색한다
+        Bag b;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (size_t i = 0; i < w.keys.size(); i++) {
+            if (i % 20 == 19)
+                found += b.count(w.keys[i / 2]);
+            else
+                b.insert(w.keys[i]);
+        }
+        r.mixed = nanoseconds_per(start, w.keys.size());
+    }
+
+    if (found == size_t(-1)) // 검색이 최적화로 사라지지 않도록
+        printf("unreachable\n");
+    return r;
+}
+
+static void report(const char *name, const result &r) {
+    printf("  %-26s %10.1f %10.1f %10.1f\n", name, r.insert, r.mixed,
+           r.count);
+}
+
+int main(int argc, char **argv) {
+    size_t ops = 2000000;
+    int range = 1 << 30;
+
+    if (argc > 1)
+        ops = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        range = atoi(argv[2]);
+    if (range <= 0)
+        range = 1;
+
+    check(200000, 5000);
+    printf("check passed\n\n");
+
+    mt19937 rng(1);
+    workload workloads[3] = {{"uniform", vector<int>(), vector<int>()},
+                             {"duplicates", vector<int>(), vector<int>()},
+                             {"sorted", vector<int>(), vector<int>()}};
+    // duplicates는 키 하나가 평균 20번 들어가도록 키 범위를 줄인다
+    int duplicate_range = ops / 20 > 0 ? ops / 20 : 1;
+    if (duplicate_range > range)
+        duplicate_range = range;
+    for (size_t i = 0; i < ops; i++) {
+        workloads[0].keys.push_back(rng() % range);
+        workloads[1].keys.push_back(rng() % duplicate_range);
+        workloads[2].keys.push_back(i);
+    }
+    for (size_t i = 0; i < 1000000; i++) {
+        workloads[0].probes.push_back(rng() % range);
+        workloads[1].probes.push_back(rng() % duplicate_range);
+        workloads[2].probes.push_back(rng() % ops);
+    }
+
+    printf("%zu ops, ns per op\n", ops);
+    for (size_t i = 0; i < 3; i++) {
+        printf("%s\n", workloads[i].name);
+        printf("  %-26s %10s %10s %10s\n", "", "insert", "95% insert",
+               "count");
+        // 중복이 많으면 bag은 같은 키가 여러 노드에 걸쳐 저장되어 느려지므로
+        // run-length 모드도 함께 비교한다
+        report("bag<int>", run<bag<int> >(workloads[i]));
+        report("run_length_bag<int>", run<run_length_bag<int> >(workloads[i]));
+        report("buffered_bag<int>", run<buffered_bag<int> >(workloads[i]));
+        report("buffered_bag<int,32,1024>",
+               run<buffered_bag<int, 32, 1024> >(workloads[i]));
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+/* concurrent_bag의 스트레스 테스트와 처리량 벤치마크입니다.
+ *
+ *   g++ -std=c++17 -O2 -pthread -I.. concurrent_bench.cpp -o concurrent_bench
+ *   ./concurrent_bench [최대 스레드 수] [스레드당 연산 수] [count 비율(%)]
+ *
+ * 먼저 여러 스레드가 같은 노드들에 섞여 들어가도록 키를 나눠 삽입과 삭제를
+ * 동시에 수행한 후 결과를 검사합니다. 그 다음 스레드 수를 1부터 두배씩 늘리면서
+ * concurrent_bag과 mutex 하나로 감싼 bag의 초당 연산 수를 비교합니다. */
+
+#include "../concurrent_bag.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// mutex_bag은 비교 대상으로 쓰는, bag 전체를 mutex 하나로 감싼 bag입니다.
+class mutex_bag {
+  public:
+    size_t count(int target) const {
+        lock_guard<mutex> guard(lock);
+        return b.count(target);
+    }
+    void insert(int entry) {
+        lock_guard<mutex> guard(lock);
+        b.insert(entry);
+    }
+    bool erase_one(int target) {
+        lock_guard<mutex> guard(lock);
+        return b.erase_one(target);
+    }
+
+  private:
+    mutable mutex lock;
+    bag<int> b;
+};
+
+static void fail(const char *message) {
+    printf("stress test failed: %s\n", message);
+    exit(1);
+}
+
+// stress_test()는 threads개의 스레드가 키를 나눠 동시에 삽입, 삭제, 검색한 후
+// 모든 키의 개수가 예상과 같은지 검사하는 함수입니다. 스레드 t는 k % threads
+// == t 인 키만 바꾸므로 다른 스레드의 키와 같은 노드를 공유하게 됩니다.
+static void stress_test(size_t threads, size_t keys) {
+    concurrent_bag<int, 2> b; // 분할과 merge가 자주 일어나도록 작은 노드
+    vector<thread> workers;
+
+    // 각 키를 세번씩 넣고, 그 사이에 다른 스레드의 키를 검색한다
+    for (size_t t = 0; t < threads; t++) {
+        workers.push_back(thread([&b, t, threads, keys]() {
+            mt19937 rng(t);
+            for (size_t round = 0; round < 3; round++) {
+                for (size_t k = t; k < keys; k += threads) {
+                    b.insert(k);
+                    if (b.count(rng() % keys) > 3)
+                        fail("count above 3 while inserting");
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads; t++)
+        workers[t].join();
+    workers.clear();
+    if (b.size() != 3 * keys)
+        fail("size after insert");
+
+    // 각 키를 두번씩 지우면서 삽입과 삭제를 섞는다
+    for (size_t t = 0; t < threads; t++) {
+        workers.push_back(thread([&b, t, threads, keys]() {
+            mt19937 rng(t + 1000);
+            for (size_t k = t; k < keys; k += threads) {
+                if (!b.erase_one(k) || !b.erase_one(k))
+                    fail("erase_one missed an item");
+                b.insert(k + keys); // 범위 밖의 키를 넣었다가 지운다
+                if (b.count(k) != 1)
+                    fail("own key count after erase");
+                if (!b.erase_one(k + keys))
+                    fail("erase_one of temporary key");
+                b.count(rng() % keys);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads; t++)
+        workers[t].join();
+
+    if (b.size() != keys)
+        fail("size after erase");
+    for (size_t k = 0; k < keys; k++) {
+        if (b.count(k) != 1)
+            fail("final count");
+        if (b.count(k + keys) != 0)
+            fail("temporary key left");
+    }
+
+    // 모든 데이터를 지우면 빈 bag이 되어야 한다
+    for (size_t t = 0; t < threads; t++) {
+        workers[t] = thread([&b, t, threads, keys]() {
+            for (size_t k = t; k < keys; k += threads)
+                if (!b.erase_one(k))
+                    fail("erase_one while draining");
+        });
+    }
+    for (size_t t = 0; t < threads; t++)
+        workers[t].join();
+    if (!b.empty())
+        fail("not empty after draining");
+}
+
+// run_mix()는 threads개의 스레드가 각각 ops번의 연산을 수행하는데 걸린
+// 시간으로 초당 연산 수를 구하는 함수입니다. 연산의 read_percent%는 count()이고
+// 나머지는 insert()와 erase_one()이 반씩입니다.
+template <class Bag>
+static double run_mix(Bag &b, size_t threads, size_t ops, size_t read_percent,
+                      size_t keys) {
+    vector<thread> workers;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (size_t t = 0; t < threads; t++) {
+        workers.push_back(thread([&b, t, ops, read_percent, keys]() {
+            mt19937 rng(t * 7919 + 1);
+            size_t found = 0;
+            for (size_t i = 0; i < ops; i++) {
+                int key = rng() % keys;
+                size_t dice = rng() % 100;
+                if (dice < read_percent)
+                    found += b.count(key);
+                else if (dice % 2 == 0)
+                    b.insert(key);
+                else
+                    b.erase_one(key);
+            }
+            if (found == size_t(-1)) // 검색이 최적화로 사라지지 않도록
+                printf("unreachable\n");
+        }));
+    }
+    for (size_t t = 0; t < threads; t++)
+        workers[t].join();
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return threads * ops / elapsed.count();
+}
+
+int main(int argc, char **argv) {
+    size_t max_threads = thread::hardware_concurrency();
+    size_t ops = 1000000;
+    size_t read_percent = 95;
+    const size_t keys = 1000000;
+
+    if (argc > 1)
+        max_threads = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        ops = strtoul(argv[2], NULL, 10);
+    if (argc > 3)
+        read_percent = strtoul(argv[3], NULL, 10);
+    if (max_threads == 0)
+        max_threads = 1;
+
+    for (size_t threads = 1; threads <= max_threads * 2; threads *= 2)
+        stress_test(threads, 20000);
+    printf("stress test passed (up to %zu threads)\n\n", max_threads * 2);
+
+    printf("%zu%% count, %zu ops per thread, %zu keys\n", read_percent, ops,
+           keys);
+    printf("%8s %18s %18s\n", "threads", "concurrent Mops/s", "mutex Mops/s");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        concurrent_bag<int> cb;
+        mutex_bag mb;
+        for (size_t k = 0; k < keys; k += 2) { // 키의 절반을 미리 넣는다
+            cb.insert(k);
+            mb.insert(k);
+        }
+        double c = run_mix(cb, threads, ops, read_percent, keys);
+        double m = run_mix(mb, threads, ops, read_percent, keys);
+        printf("%8zu %18.2f %18.2f\n", threads, c / 1e6, m / 1e6);
+    }
+    return 0;
+}
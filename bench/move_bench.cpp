@@ -0,0 +1,203 @@
+/* bag이 데이터를 복사하지 않고 move 하는지 검사하는 벤치마크입니다.
+ *
+ *   g++ -std=c++17 -O2 -I.. move_bench.cpp -o move_bench
+ *   ./move_bench [데이터 수] [문자열 길이]
+ *
+ * 먼저 복사 횟수를 세는 데이터로 insert(), emplace(), erase_one(),
+ * erase_all()과 bag의 move를 수행하면서, 그 사이 fix_excess()의 분할,
+ * fix_shortage()의 빌려오기와 merge_child()의 합치기가 모두 일어났는지와
+ * 데이터가 한번도 복사되지 않았는지를 노드 형식마다 검사합니다. 그 다음 긴
+ * 문자열을 복사해서 넣을때와 move 해서 넣을때의 시간을 비교합니다. */
+
+#include "../bag.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// counted는 복사될때마다 copies를 늘리는 데이터입니다. move는 세지 않는다.
+struct counted {
+    static size_t copies;
+    string text;
+
+    counted() {}
+    explicit counted(int key) : text(to_string(key) + string(24, 'x')) {}
+    counted(const char *prefix, int key) : text(prefix + to_string(key)) {}
+    counted(const counted &source) : text(source.text) { copies++; }
+    counted(counted &&source) noexcept : text(std::move(source.text)) {}
+    counted &operator=(const counted &source) {
+        text = source.text;
+        copies++;
+        return *this;
+    }
+    counted &operator=(counted &&source) noexcept {
+        text = std::move(source.text);
+        return *this;
+    }
+    bool operator<(const counted &other) const { return text < other.text; }
+    bool operator==(const counted &other) const { return text == other.text; }
+};
+
+size_t counted::copies = 0;
+
+static void fail(const char *message) {
+    printf("check failed: %s\n", message);
+    exit(1);
+}
+
+static double nanoseconds_per(chrono::steady_clock::time_point start,
+                              size_t ops) {
+    chrono::duration<double, nano> elapsed =
+        chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+// check_contents()는 b의 데이터가 expected의 (문자열, 개수)와 같은지 검사하는
+// 함수입니다. 순회는 참조로 하므로 복사가 일어나지 않는다.
+template <class Bag>
+static void check_contents(const Bag &b, const map<string, size_t> &expected) {
+    size_t total = 0;
+    for (map<string, size_t>::const_iterator it = expected.begin();
+         it != expected.end(); ++it)
+        total += it->second;
+    if (b.size() != total)
+        fail("size");
+
+    typename Bag::const_iterator cursor = b.begin();
+    for (map<string, size_t>::const_iterator it = expected.begin();
+         it != expected.end(); ++it)
+        for (size_t i = 0; i < it->second; i++, ++cursor)
+            if (cursor == b.end() || cursor->text != it->first)
+                fail("contents");
+}
+
+// check_moves()는 n개의 데이터로 트리를 키우고 줄이면서 복사 횟수가 0인지
+// 검사하는 함수입니다. MINIMUM이 작은 Bag을 써서 분할과 합치기가 자주
+// 일어나게 한다.
+template <class Bag> static void check_moves(const char *name, size_t n) {
+    mt19937 rng(7);
+    int range = int(n / 4) + 1;
+    map<string, size_t> expected;
+    Bag b;
+    counted::copies = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        counted entry(int(rng() % range));
+        expected[entry.text]++;
+        b.insert(std::move(entry));
+    }
+    for (size_t i = 0; i < n / 4; i++) {
+        int key = int(rng() % range);
+        expected["e" + to_string(key)]++;
+        b.emplace("e", key);
+    }
+    if (counted::copies != 0)
+        fail("insert() or emplace() copied an item");
+    if (b.counters().splits == 0)
+        fail("fix_excess() was not exercised");
+    check_contents(b, expected);
+
+    for (size_t i = 0; i < n; i++) {
+        counted target(int(rng() % range));
+        map<string, size_t>::iterator it = expected.find(target.text);
+        bool found = b.erase_one(target);
+        if (found != (it != expected.end()))
+            fail("erase_one() result");
+        if (found && --it->second == 0)
+            expected.erase(it);
+    }
+    for (int key = 0; key < range; key += 3) {
+        counted target("e", key);
+        map<string, size_t>::iterator it = expected.find(target.text);
+        size_t removed = b.erase_all(target);
+        if (removed != (it == expected.end() ? 0 : it->second))
+            fail("erase_all() result");
+        if (it != expected.end())
+            expected.erase(it);
+    }
+    if (counted::copies != 0)
+        fail("erase_one() or erase_all() copied an item");
+    bag_counters c = b.counters();
+    if (c.borrow_left == 0 || c.borrow_right == 0)
+        fail("fix_shortage() rotations were not exercised");
+    if (c.merges == 0)
+        fail("merge_child() was not exercised");
+    check_contents(b, expected);
+
+    // bag을 move 하면 노드를 그대로 넘기므로 데이터는 움직이지도 않는다
+    Bag moved(std::move(b));
+    Bag assigned;
+    assigned = std::move(moved);
+    if (counted::copies != 0)
+        fail("moving the bag copied an item");
+    if (!b.empty() || !moved.empty())
+        fail("moved-from bag is not empty");
+    check_contents(assigned, expected);
+
+    // move 된 bag도 다시 쓸수 있다
+    b.insert(counted(1));
+    if (b.size() != 1 || counted::copies != 0)
+        fail("reusing a moved-from bag");
+
+    printf("  %-24s splits %zu, borrows %zu, merges %zu, copies 0\n", name,
+           size_t(c.splits), size_t(c.borrow_left + c.borrow_right),
+           size_t(c.merges));
+}
+
+// time_insert()는 길이 length의 문자열 n개를 복사해서 넣을때와 move 해서
+// 넣을때의 데이터당 시간을 재는 함수입니다.
+static void time_insert(size_t n, size_t length) {
+    mt19937 rng(13);
+    vector<string> source;
+    for (size_t i = 0; i < n; i++)
+        source.push_back(to_string(rng()) + string(length, 'x'));
+
+    bag<string> copied;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+        copied.insert(source[i]);
+    double copy_ns = nanoseconds_per(start, n);
+
+    bag<string> moved;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++)
+        moved.insert(std::move(source[i]));
+    double move_ns = nanoseconds_per(start, n);
+
+    printf("  %10zu %8zu %12.0f %12.0f\n", n, length, copy_ns, move_ns);
+}
+
+int main(int argc, char **argv) {
+    size_t n = 200000;
+    size_t length = 64;
+
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        length = strtoul(argv[2], NULL, 10);
+    if (n < 1)
+        n = 1;
+
+    check_moves<bag<counted, 2, allocator<counted>, BAG_INSTRUMENT> >(
+        "bag<counted, 2>", 20000);
+    check_moves<bag<counted, 2, allocator<counted>,
+                    BAG_RUN_LENGTH | BAG_INSTRUMENT> >("run-length", 20000);
+    check_moves<bag<counted, 3, allocator<counted>,
+                    BAG_ORDER_STATS | BAG_INSTRUMENT> >("order statistics",
+                                                        20000);
+    check_moves<bag<counted, 16, allocator<counted>, BAG_INSTRUMENT> >(
+        "bag<counted, 16>", 100000);
+    printf("check passed\n\n");
+
+    printf("insert of strings, ns per item\n");
+    printf("  %10s %8s %12s %12s\n", "n", "length", "copy", "move");
+    time_insert(n, length);
+    time_insert(n, length * 4);
+    return 0;
+}
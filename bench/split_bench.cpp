@@ -0,0 +1,224 @@
+/* split()과 join()으로 bag 사이에 데이터를 옮기는 벤치마크입니다.
+ *
+ *   g++ -std=c++17 -O2 -I.. split_bench.cpp -o split_bench
+ *   ./split_bench [shard 수] [shard당 데이터 수] [옮기는 횟수]
+ *
+ * 먼저 한 bag에서 split()으로 떼어낸 조각을 따로 만든 다른 bag에 join() 할때
+ * merge()처럼 트리를 다시 만들지 않는지, 즉 할당한 노드 수가 트리의 높이에
+ * 비례하는지 검사합니다. 그 다음 키 범위로 나눈 shard들의 경계를 무작위로
+ * 옮기는 재분배를 split()과 join()으로 수행하고 결과를 검사한 후, 데이터 수를
+ * 10배씩 늘리면서 다른 bag으로 옮기는 split()과 join()의 시간을 잽니다. */
+
+#include "../bag.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+typedef bag<int, 8, allocator<int>, BAG_INSTRUMENT> counted_bag;
+
+static void fail(const char *message) {
+    printf("check failed: %s\n", message);
+    exit(1);
+}
+
+static double nanoseconds_per(chrono::steady_clock::time_point start,
+                              size_t ops) {
+    chrono::duration<double, nano> elapsed =
+        chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+// fill()은 [low, high)의 키 n개를 무작위로 b에 넣는 함수입니다.
+template <class Bag>
+static void fill(Bag &b, size_t n, int low, int high, mt19937 &rng) {
+    vector<int> keys;
+    for (size_t i = 0; i < n; i++)
+        keys.push_back(low + int(rng() % (high - low)));
+    b.assign(keys.begin(), keys.end());
+}
+
+// check_adopt()는 b에서 split()으로 떼어낸 조각을 따로 만든 other에 join()
+// 하는 것을 반복하면서, join()이 할당한 노드 수가 높이에 비례하는지 검사하는
+// 함수입니다. 조각은 b와 pool을 공유하므로 other의 노드가 그 pool로 옮겨진다.
+static void check_adopt(size_t n, size_t rounds) {
+    mt19937 rng(3);
+    for (size_t round = 0; round < rounds; round++) {
+        counted_bag b, other;
+        fill(b, n, int(n), int(3 * n), rng);
+        fill(other, n / 2, 0, int(n), rng);
+        size_t total = b.size() + other.size();
+
+        int key = int(n) + int(rng() % (2 * n));
+        counted_bag piece = b.split(key);
+        size_t height = other.stats().height + piece.stats().height;
+        size_t moved = piece.size();
+
+        other.reset_counters();
+        other.join(std::move(piece));
+        if (other.counters().node_allocs > 2 * height + 2)
+            fail("join() rebuilt the tree");
+        if (!piece.empty() || b.size() + other.size() != total)
+            fail("size after join()");
+        if (b.count(key) != 0 || other.size() != n / 2 + moved)
+            fail("contents after join()");
+
+        // 이제 세 bag이 pool을 공유하므로 other의 윗부분을 b 뒤에 다시
+        // 붙이는 것도 노드를 옮기지 않는다
+        counted_bag upper = other.split(int(n));
+        b.reset_counters();
+        b.join(std::move(upper));
+        if (b.counters().node_allocs > 2 * height + 2)
+            fail("join() of shared pools rebuilt the tree");
+        if (b.size() + other.size() != total || other.size() != n / 2)
+            fail("size after second join()");
+    }
+}
+
+// repartition()은 키 범위 [bounds[i], bounds[i+1])를 가지는 shard들의 경계를
+// 무작위로 옮기는 함수입니다. 경계가 왼쪽으로 가면 왼쪽 shard의 윗부분을
+// split()으로 떼어 오른쪽 shard 앞에 join()하고, 오른쪽으로 가면 오른쪽
+// shard의 아랫부분을 왼쪽 shard 뒤에 join()한다.
+template <class Bag>
+static void repartition(vector<Bag> &shards, vector<int> &bounds,
+                        size_t moves, mt19937 &rng) {
+    for (size_t m = 0; m < moves; m++) {
+        size_t i = 1 + rng() % (shards.size() - 1);
+        int low = bounds[i - 1] + 1;
+        int key = low + int(rng() % (bounds[i + 1] - low));
+        if (key < bounds[i]) {
+            Bag upper = shards[i - 1].split(key);
+            upper.join(std::move(shards[i]));
+            shards[i] = std::move(upper);
+        } else {
+            Bag upper = shards[i].split(key);
+            shards[i - 1].join(std::move(shards[i]));
+            shards[i] = std::move(upper);
+        }
+        bounds[i] = key;
+    }
+}
+
+// check_repartition()은 repartition() 후 각 shard가 자기 키 범위의 데이터를
+// 정확히 가지는지 검사하는 함수입니다.
+static void check_repartition(size_t shard_count, size_t n, size_t moves) {
+    mt19937 rng(5);
+    int range = int(shard_count * n);
+    vector<int> keys;
+    for (size_t i = 0; i < shard_count * n; i++)
+        keys.push_back(int(rng() % range));
+    sort(keys.begin(), keys.end());
+
+    // shard는 한 bag을 split()으로 나눠서 만들므로 모두 같은 pool을 가진다
+    counted_bag all;
+    all.assign(keys.begin(), keys.end());
+    vector<counted_bag> shards(shard_count);
+    vector<int> bounds(shard_count + 1);
+    bounds[0] = -1;
+    bounds[shard_count] = range;
+    for (size_t i = shard_count - 1; i > 0; i--) {
+        bounds[i] = int(i * n);
+        shards[i] = all.split(bounds[i]);
+    }
+    shards[0] = std::move(all);
+
+    for (size_t i = 0; i < shard_count; i++)
+        shards[i].reset_counters();
+    repartition(shards, bounds, moves, rng);
+
+    size_t allocs = 0;
+    for (size_t i = 0; i < shard_count; i++) {
+        allocs += shards[i].counters().node_allocs;
+        vector<int>::iterator first =
+            lower_bound(keys.begin(), keys.end(), bounds[i]);
+        vector<int>::iterator last =
+            lower_bound(keys.begin(), keys.end(), bounds[i + 1]);
+        if (shards[i].size() != size_t(last - first) ||
+            !equal(first, last, shards[i].begin()))
+            fail("shard contents after repartition");
+    }
+    // 옮길 때마다 경로의 노드만 나누므로 데이터 수가 아닌 높이에 비례한다
+    if (allocs > moves * 64)
+        fail("repartition rebuilt trees");
+}
+
+// time_moves()는 shard 하나의 윗부분을 따로 만든 다른 shard로 옮기는
+// split()과 join()의 시간을 재는 함수입니다.
+template <class Bag> static void time_moves(const char *name, size_t n) {
+    const size_t rounds = 200;
+    mt19937 rng(11);
+    double split_ns = 0, join_ns = 0;
+    for (size_t round = 0; round < rounds; round++) {
+        Bag source, target;
+        fill(source, n, int(n), int(2 * n), rng);
+        fill(target, n, 0, int(n), rng);
+        int key = int(n) + int(rng() % n);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Bag piece = source.split(key);
+        split_ns += nanoseconds_per(start, 1);
+
+        start = chrono::steady_clock::now();
+        target.join(std::move(piece));
+        join_ns += nanoseconds_per(start, 1);
+    }
+    printf("  %-24s %10zu %12.0f %12.0f\n", name, n, split_ns / rounds,
+           join_ns / rounds);
+}
+
+int main(int argc, char **argv) {
+    size_t shard_count = 8;
+    size_t per_shard = 100000;
+    size_t moves = 10000;
+
+    if (argc > 1)
+        shard_count = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        per_shard = strtoul(argv[2], NULL, 10);
+    if (argc > 3)
+        moves = strtoul(argv[3], NULL, 10);
+    if (shard_count < 2)
+        shard_count = 2;
+    if (per_shard < 2)
+        per_shard = 2;
+
+    check_adopt(1000, 200);
+    check_adopt(100000, 5);
+    check_repartition(4, 2000, 2000);
+    printf("check passed\n\n");
+
+    // 경계를 옮기는 재분배의 이동당 시간
+    mt19937 rng(1);
+    vector<int> keys;
+    int range = int(shard_count * per_shard);
+    for (size_t i = 0; i < shard_count * per_shard; i++)
+        keys.push_back(int(rng() % range));
+    bag<int> all;
+    all.assign(keys.begin(), keys.end());
+    vector<bag<int> > shards(shard_count);
+    vector<int> bounds(shard_count + 1);
+    bounds[0] = -1;
+    bounds[shard_count] = range;
+    for (size_t i = shard_count - 1; i > 0; i--) {
+        bounds[i] = int(i * per_shard);
+        shards[i] = all.split(bounds[i]);
+    }
+    shards[0] = std::move(all);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    repartition(shards, bounds, moves, rng);
+    printf("%zu shards of %zu, %zu boundary moves: %.0f ns per move\n\n",
+           shard_count, per_shard, moves, nanoseconds_per(start, moves));
+
+    printf("split into another bag, ns per op\n");
+    printf("  %-24s %10s %12s %12s\n", "", "n", "split", "join");
+    for (size_t n = 1000; n <= 1000000; n *= 10) {
+        time_moves<bag<int> >("bag<int>", n);
+        time_moves<order_statistic_bag<int> >("order_statistic_bag<int>", n);
+    }
+    return 0;
+}
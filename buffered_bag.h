@@ -0,0 +1,488 @@
+#ifndef BUFFERED_BAG_H
+#define BUFFERED_BAG_H
+
+#include "bag_search.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/* buffered_bag은 삽입이 대부분인 경우를 위한 write-optimized B-tree(B^ε-tree)
+ * bag입니다. 내부노드는 자식마다 아직 그 자식으로 내려보내지 않은 메시지의
+ * 목록(buffer)을 가집니다. 메시지는 데이터와 그 개수의 변화량이며, insert()는
+ * +1, erase는 음수의 메시지가 됩니다.
+ *
+ * insert()는 최상위 노드에서 자식의 위치만 찾아 그 buffer의 뒤에 메시지를
+ * 붙입니다. 한 노드의 메시지가 BUFFER개를 넘으면 메시지가 가장 많이 모인
+ * 자식을 골라 그 buffer를 한번에 내려보내고, 자식의 메시지가 넘치면 같은
+ * 방법으로 다시 내려보냅니다. 한번에 내려가는 메시지는 BUFFER / FANOUT개
+ * 이상이므로 노드 하나를 읽고 고치는 비용을 여러 메시지가 나눠 가집니다.
+ *
+ * 리프노드는 같은 데이터를 한번만 저장하고 그 개수를 함께 가집니다. 리프노드에
+ * 도착한 메시지들은 정렬해서 같은 데이터끼리 합친 후 리프노드에 merge 하고,
+ * 개수가 0이 된 데이터는 지웁니다. count()는 내려가는 경로에서 target이 갈
+ * 자식의 buffer를 모두 확인하므로 아직 리프노드에 닿지 않은 삽입과 삭제도
+ * 바로 반영됩니다.
+ *
+ * erase_one()과 erase_all()은 target이 몇개 있는지 알아야 하므로 count()만큼
+ * 내려간 후에 메시지를 넣습니다. 삭제로 노드가 작아져도 형제와 합치지
+ * 않으므로 트리의 크기는 지금까지 들어온 서로 다른 데이터의 수로 정해집니다.
+ * 많이 삭제한 후에는 clear()로 비우거나 새로 만들어야 합니다. */
+
+template <class Item, size_t FANOUT = 16, size_t BUFFER = 256>
+class buffered_bag {
+  public:
+    // Default Constructor
+    buffered_bag();
+
+    // Destructor
+    ~buffered_bag();
+
+    // count() 함수는 현재 bag에 target이 몇개 존재하는지 반환하는 함수입니다.
+    // 경로에 있는 buffer의 메시지를 모두 더합니다.
+    // Pre : None.
+    // Post : bag에 있는 target의 개수를 반환. 없을 시 0 반환.
+    size_t count(const Item &target) const;
+
+    // insert() 함수는 현재 bag에 entry를 삽입하는 함수입니다. 최상위 노드의
+    // buffer에 메시지를 붙이고, buffer가 넘칠때만 메시지를 내려보냅니다.
+    // Pre : None.
+    // Post : bag에 entry가 추가된다.
+    void insert(const Item &entry);
+
+    // erase_one() 함수는 현재 bag에서 target 하나를 제거하는 함수입니다.
+    // Pre : None.
+    // Post : bag에 target이 존재하면 삭제후 true 반환.
+    //        target이 존재하지 않으면 false 반환.
+    bool erase_one(const Item &target);
+
+    // erase_all() 함수는 현재 bag에서 target을 모두 제거하는 함수입니다.
+    // Pre : None.
+    // Post : bag에서 target을 모두 삭제후 삭제한 개수를 반환.
+    size_t erase_all(const Item &target);
+
+    // size() 함수는 bag에 들어있는 데이터의 수를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : 아직 buffer에 있는 삽입과 삭제를 반영한 데이터 수를 반환.
+    size_t size() const;
+
+    // empty() 함수는 bag이 비어있는지 확인하는 함수입니다.
+    // Pre : None.
+    // Post : size() == 0 이면 true 반환.
+    bool empty() const;
+
+    // flush() 함수는 buffer에 있는 모든 메시지를 리프노드까지 내려보내는
+    // 함수입니다. 이후의 count()는 buffer를 보지 않고 리프노드에서 답을
+    // 구하게 됩니다.
+    // Pre : None.
+    // Post : 모든 내부노드의 buffer가 비어있다.
+    void flush();
+
+    // clear() 함수는 현재 bag을 빈 bag으로 만드는 함수입니다.
+    // Pre : None.
+    // Post : 모든 노드를 해제한다.
+    void clear();
+
+  private:
+    static_assert(FANOUT >= 4, "buffered_bag needs FANOUT >= 4");
+    static_assert(BUFFER >= FANOUT, "buffered_bag needs BUFFER >= FANOUT");
+
+    // 리프노드가 가질수 있는 서로 다른 데이터의 최대 수
+    static const size_t LEAF_MAXIMUM = BUFFER;
+
+    // 내부노드의 pivots에서 자식의 위치를 찾는 검색 커널
+    typedef typename bag_search_traits<Item>::type search;
+
+    // entry는 리프노드에서는 데이터와 그 개수이고, 내부노드의 buffer에서는
+    // 데이터와 아직 내려보내지 않은 개수의 변화량(메시지)입니다.
+    struct entry {
+        Item item;
+        ptrdiff_t count;
+    };
+
+    // 노드에 들어가는 데이터와 메시지의 수가 한번에 내려오는 양에 따라 크게
+    // 바뀌므로 bag과 달리 고정 크기 배열 대신 vector를 사용한다.
+    struct node {
+        bool leaf;                  // 리프노드이면 true
+        std::vector<entry> entries; // 리프노드의 데이터. 오름차순이다
+        std::vector<Item> pivots;   // children[i]의 데이터는 pivots[i]보다
+                                    // 작고 children[i+1]의 데이터는 그 이상
+        std::vector<node *> children;
+        std::vector<std::vector<entry> > buffers; // buffers[i]는 children[i]로
+                                                  // 갈 메시지. 도착한 순서
+        size_t buffered; // buffers에 있는 메시지의 수
+
+        explicit node(bool is_leaf);
+    };
+
+    node *root;        // 최상위 노드. bag이 비어있다면 NULL일수 있다
+    size_t item_count; // bag에 들어있는 데이터의 수
+
+    // add_message()는 target의 개수를 delta만큼 바꾸는 메시지를 최상위 노드에
+    // 넣는 함수입니다.
+    // Pre : delta != 0 이고, delta < 0 이면 target이 -delta개 이상 있다.
+    // Post : 메시지가 추가되고 넘치는 buffer와 노드가 정리된다.
+    void add_message(const Item &target, ptrdiff_t delta);
+
+    // child_index()는 내부노드 n에서 item이 갈 자식의 위치를 찾는 함수입니다.
+    // Pre : n은 내부노드이다.
+    // Post : pivots[i] <= item 인 i의 개수를 반환.
+    static size_t child_index(const node *n, const Item &item);
+
+    // push_down()은 n->buffers[i]의 메시지를 모두 n->children[i]로 내려보내는
+    // 함수입니다. 자식이 내부노드라면 메시지마다 손자의 buffer에 붙이고,
+    // 리프노드라면 apply_to_leaf()로 데이터에 합칩니다.
+    // Pre : n은 내부노드이고 i < n->children.size()
+    // Post : n->buffers[i]가 비어있다. 자식은 넘칠수 있다.
+    static void push_down(node *n, size_t i);
+
+    // apply_to_leaf()는 메시지들을 리프노드의 데이터에 합치는 함수입니다.
+    // 메시지를 정렬해서 같은 데이터끼리 합친 후 뒤에서부터 merge 합니다.
+    // Pre : leaf는 리프노드이다.
+    // Post : 메시지만큼 데이터의 개수가 바뀌고 0이 된 데이터는 지워진다.
+    //        messages의 내용은 정해지지 않는다.
+    static void apply_to_leaf(node *leaf, std::vector<entry> &messages);
+
+    // flush_node()는 n의 메시지가 BUFFER개 이하가 될때까지 메시지가 가장 많이
+    // 모인 자식에게 메시지를 내려보내는 함수입니다.
+    // Pre : n은 내부노드이다.
+    // Post : n의 메시지는 BUFFER개 이하이고 n의 자식들은 넘치지 않는다. n의
+    //        자식 수는 FANOUT을 넘을수 있다.
+    void flush_node(node *n);
+
+    // flush_all()은 n을 루트로 하는 서브트리의 모든 메시지를 리프노드까지
+    // 내려보내는 함수입니다.
+    // Pre : n != NULL
+    // Post : 서브트리의 buffer가 모두 비어있다. n의 자식 수는 FANOUT을 넘을수
+    //        있다.
+    void flush_all(node *n);
+
+    // overfull()은 n이 나눠야 할 만큼 큰지 확인하는 함수입니다.
+    // Pre : n != NULL
+    // Post : 리프노드가 LEAF_MAXIMUM개보다 많은 데이터를 가지거나 내부노드가
+    //        FANOUT개보다 많은 자식을 가지면 true 반환.
+    static bool overfull(const node *n);
+
+    // split_child()는 넘치는 n->children[i]를 최대 크기의 절반 이상이 되는
+    // 여러 노드로 나누는 함수입니다. 내부노드를 나눌때는 자식들의 buffer도
+    // 자식과 함께 옮깁니다.
+    // Pre : overfull(n->children[i])이고 n->buffers[i]가 비어있다.
+    // Post : 나눈 노드들이 children[i]부터 차례로 들어가고 그 사이의 pivot이
+    //        n에 추가된다.
+    static void split_child(node *n, size_t i);
+
+    // grow_root()는 최상위 노드가 넘치면 새 최상위 노드를 만들고 나누는
+    // 함수입니다.
+    // Pre : root != NULL
+    // Post : overfull(root)가 false이다.
+    void grow_root();
+
+    // destroy_tree()는 n을 루트로 하는 서브트리를 모두 해제하는 함수입니다.
+    // Pre : n != NULL
+    // Post : 서브트리의 모든 노드가 해제된다.
+    static void destroy_tree(node *n);
+
+    buffered_bag(const buffered_bag &);
+    buffered_bag &operator=(const buffered_bag &);
+};
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+buffered_bag<Item, FANOUT, BUFFER>::node::node(bool is_leaf) {
+    leaf = is_leaf;
+    buffered = 0;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+buffered_bag<Item, FANOUT, BUFFER>::buffered_bag() {
+    root = NULL;
+    item_count = 0;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+buffered_bag<Item, FANOUT, BUFFER>::~buffered_bag() {
+    clear();
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+size_t buffered_bag<Item, FANOUT, BUFFER>::count(const Item &target) const {
+    ptrdiff_t total = 0;
+    const node *n = root;
+    if (n == NULL)
+        return 0;
+
+    // 내부노드에서는 target이 갈 자식의 buffer에서 target의 메시지를 더한다
+    while (!n->leaf) {
+        size_t i = child_index(n, target);
+        const std::vector<entry> &messages = n->buffers[i];
+        for (size_t j = 0; j < messages.size(); j++)
+            if (!(messages[j].item < target) && !(target < messages[j].item))
+                total += messages[j].count;
+        n = n->children[i];
+    }
+
+    typename std::vector<entry>::const_iterator it =
+        std::lower_bound(n->entries.begin(), n->entries.end(), target,
+                         [](const entry &e, const Item &item) {
+                             return e.item < item;
+                         });
+    if (it != n->entries.end() && !(target < it->item))
+        total += it->count;
+    assert(total >= 0);
+    return total;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::insert(const Item &entry) {
+    add_message(entry, 1);
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+bool buffered_bag<Item, FANOUT, BUFFER>::erase_one(const Item &target) {
+    if (count(target) == 0)
+        return false;
+    add_message(target, -1);
+    return true;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+size_t buffered_bag<Item, FANOUT, BUFFER>::erase_all(const Item &target) {
+    size_t removed = count(target);
+    if (removed > 0)
+        add_message(target, -static_cast<ptrdiff_t>(removed));
+    return removed;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+size_t buffered_bag<Item, FANOUT, BUFFER>::size() const {
+    return item_count;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+bool buffered_bag<Item, FANOUT, BUFFER>::empty() const {
+    return item_count == 0;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::flush() {
+    if (root == NULL)
+        return;
+    flush_all(root);
+    grow_root();
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::clear() {
+    if (root != NULL)
+        destroy_tree(root);
+    root = NULL;
+    item_count = 0;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::add_message(const Item &target,
+                                                     ptrdiff_t delta) {
+    assert(delta != 0); // Precondition
+
+    if (root == NULL)
+        root = new node(true); // 빈 bag이라면 리프노드 하나로 시작한다
+    item_count += delta;
+
+    entry message = {target, delta};
+    if (root->leaf) {
+        // 최상위 노드가 리프노드라면 데이터에 바로 합친다
+        std::vector<entry> messages(1, message);
+        apply_to_leaf(root, messages);
+    } else {
+        root->buffers[child_index(root, target)].push_back(message);
+        if (++root->buffered > BUFFER)
+            flush_node(root);
+    }
+    grow_root();
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+size_t buffered_bag<Item, FANOUT, BUFFER>::child_index(const node *n,
+                                                       const Item &item) {
+    return search::upper_bound(n->pivots.data(), n->pivots.size(), item);
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::push_down(node *n, size_t i) {
+    assert(!n->leaf && i < n->children.size()); // Precondition
+
+    std::vector<entry> &messages = n->buffers[i];
+    node *child = n->children[i];
+    n->buffered -= messages.size();
+
+    if (child->leaf) {
+        apply_to_leaf(child, messages);
+    } else {
+        // 메시지는 정렬하지 않고 손자의 buffer 뒤에 붙이기만 한다
+        for (size_t j = 0; j < messages.size(); j++)
+            child->buffers[child_index(child, messages[j].item)].push_back(
+                std::move(messages[j]));
+        child->buffered += messages.size();
+    }
+    messages.clear(); // 할당한 메모리는 다음 메시지를 위해 남겨둔다
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::apply_to_leaf(
+    node *leaf, std::vector<entry> &messages) {
+    assert(leaf->leaf); // Precondition
+
+    // 메시지를 정렬해서 같은 데이터끼리 합친다. 삽입과 삭제가 상쇄되어 0이
+    // 된 메시지도 merge 후에 한번에 지운다.
+    std::sort(messages.begin(), messages.end(),
+              [](const entry &a, const entry &b) { return a.item < b.item; });
+    size_t k = 0;
+    for (size_t j = 0; j < messages.size(); j++) {
+        if (k > 0 && !(messages[k - 1].item < messages[j].item))
+            messages[k - 1].count += messages[j].count;
+        else if (k++ != j)
+            messages[k - 1] = std::move(messages[j]);
+    }
+
+    // 뒤에서부터 merge 하므로 새 메시지보다 작은 앞쪽 데이터는 옮기지 않는다
+    std::vector<entry> &entries = leaf->entries;
+    size_t i = entries.size(); // 아직 옮기지 않은 데이터의 수
+    size_t w = i + k;          // 다음에 채울 자리의 다음
+    entries.resize(w);
+    while (k > 0) {
+        if (i > 0 && messages[k - 1].item < entries[i - 1].item) {
+            entries[--w] = std::move(entries[--i]);
+        } else if (i > 0 && !(entries[i - 1].item < messages[k - 1].item)) {
+            entries[i - 1].count += messages[--k].count; // 같은 데이터
+            entries[--w] = std::move(entries[--i]);
+        } else {
+            entries[--w] = std::move(messages[--k]);
+        }
+    }
+
+    // 같은 데이터로 합쳐진 수만큼 [i, w)가 비어있으므로 당기고, 개수가 0이
+    // 된 데이터를 지운다
+    entries.erase(entries.begin() + i, entries.begin() + w);
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const entry &e) { return e.count == 0; }),
+                  entries.end());
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::flush_node(node *n) {
+    assert(!n->leaf); // Precondition
+
+    while (n->buffered > BUFFER) {
+        // 메시지가 가장 많이 모인 자식을 고른다
+        size_t best = 0;
+        for (size_t i = 1; i < n->children.size(); i++)
+            if (n->buffers[i].size() > n->buffers[best].size())
+                best = i;
+
+        // 고른 자식에게 메시지를 한번에 내려보낸다. 자식의 메시지가 넘치면
+        // 다시 그 아래로 내려보내고, 자식이 넘치면 나눈다.
+        node *child = n->children[best];
+        push_down(n, best);
+        if (!child->leaf)
+            flush_node(child);
+        if (overfull(child))
+            split_child(n, best);
+    }
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::flush_all(node *n) {
+    if (n->leaf)
+        return;
+
+    // 자식마다 메시지를 내려보낸 후 그 자식의 서브트리도 비운다. 나눠서 생긴
+    // 자식들도 이미 비어있으므로 건너뛴다.
+    for (size_t i = 0; i < n->children.size();) {
+        size_t before = n->children.size();
+        push_down(n, i);
+        flush_all(n->children[i]);
+        if (overfull(n->children[i]))
+            split_child(n, i);
+        i += 1 + (n->children.size() - before);
+    }
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+bool buffered_bag<Item, FANOUT, BUFFER>::overfull(const node *n) {
+    if (n->leaf)
+        return n->entries.size() > LEAF_MAXIMUM;
+    return n->children.size() > FANOUT;
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::split_child(node *n, size_t i) {
+    assert(overfull(n->children[i]) && n->buffers[i].empty()); // Precondition
+
+    node *full = n->children[i];
+    size_t units = full->leaf ? full->entries.size() : full->children.size();
+    size_t limit = full->leaf ? LEAF_MAXIMUM : FANOUT;
+
+    // 한번에 많은 메시지를 받은 노드는 둘보다 많이 나눠야 할수도 있다. 각
+    // 조각이 최대 크기의 절반 이상이 되도록 조각의 수를 정한다.
+    size_t pieces = units / (limit / 2);
+
+    // 뒤쪽 조각부터 잘라서 새 노드로 옮긴다
+    for (size_t p = pieces - 1; p > 0; p--) {
+        size_t start = units * p / pieces;
+        node *piece = new node(full->leaf);
+        Item pivot;
+
+        if (full->leaf) {
+            pivot = full->entries[start].item;
+            piece->entries.assign(
+                std::make_move_iterator(full->entries.begin() + start),
+                std::make_move_iterator(full->entries.end()));
+            full->entries.erase(full->entries.begin() + start,
+                                full->entries.end());
+        } else {
+            pivot = full->pivots[start - 1];
+            piece->children.assign(full->children.begin() + start,
+                                   full->children.end());
+            piece->pivots.assign(full->pivots.begin() + start,
+                                 full->pivots.end());
+            full->children.resize(start);
+            full->pivots.resize(start - 1);
+
+            // 자식들의 buffer는 자식과 함께 옮긴다
+            piece->buffers.resize(piece->children.size());
+            for (size_t j = 0; j < piece->buffers.size(); j++) {
+                piece->buffers[j].swap(full->buffers[start + j]);
+                piece->buffered += piece->buffers[j].size();
+            }
+            full->buffers.resize(start);
+            full->buffered -= piece->buffered;
+        }
+
+        n->children.insert(n->children.begin() + i + 1, piece);
+        n->pivots.insert(n->pivots.begin() + i, pivot);
+        n->buffers.insert(n->buffers.begin() + i + 1, std::vector<entry>());
+    }
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::grow_root() {
+    assert(root != NULL); // Precondition
+
+    while (overfull(root)) {
+        node *new_root = new node(false);
+        new_root->children.push_back(root);
+        new_root->buffers.resize(1);
+        root = new_root;
+        split_child(root, 0);
+    }
+}
+
+template <class Item, size_t FANOUT, size_t BUFFER>
+void buffered_bag<Item, FANOUT, BUFFER>::destroy_tree(node *n) {
+    for (size_t i = 0; i < n->children.size(); i++)
+        destroy_tree(n->children[i]);
+    delete n;
+}
+
+#endif
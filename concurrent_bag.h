@@ -0,0 +1,522 @@
+#ifndef CONCURRENT_BAG_H
+#define CONCURRENT_BAG_H
+
+#include "bag.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <shared_mutex>
+
+/* concurrent_bag은 여러 스레드가 동시에 사용할수 있는 B-tree bag입니다. bag
+ * 전체를 하나의 mutex로 감싸지 않고 노드마다 읽기/쓰기 latch를 두어, 서로 다른
+ * 서브트리를 사용하는 연산들이 동시에 진행될수 있습니다.
+ *
+ * 모든 연산은 루트에서 리프 방향으로만 latch를 잡습니다(latch crabbing).
+ * count()는 자식의 공유 latch를 잡은 후 부모의 latch를 놓습니다. insert()와
+ * erase_one()은 내려가면서 미리 노드를 고칩니다. insert()는 가득 찬 자식을
+ * 만나면 내려가기 전에 분할하고, erase_one()은 데이터가 MINIMUM개뿐인 자식을
+ * 만나면 형제에게서 데이터를 받아오거나 merge한 후 내려갑니다. 따라서 자식을
+ * 고친 결과가 부모로 다시 올라가지 않고, 쓰기 연산도 자식의 latch를 잡은 후
+ * 부모의 latch를 놓을수 있습니다.
+ *
+ * 가득 찬 노드를 내려가면서 바로 MINIMUM, 1, MINIMUM개로 나눌수 있도록 노드의
+ * 최대 데이터 수는 bag과 달리 2 * MINIMUM + 1 입니다.
+ *
+ * 최상위 노드를 바꿀때(루트의 분할과 merge)는 root_latch를 함께 잡습니다. 최상위
+ * 노드는 항상 존재하며, bag이 비어있다면 데이터가 없는 리프노드입니다. */
+
+template <class Item, size_t MINIMUM = bag_default_minimum<Item>::value>
+class concurrent_bag {
+  public:
+    // Default Constructor
+    concurrent_bag();
+
+    // Destructor
+    ~concurrent_bag();
+
+    // count() 함수는 현재 bag에 target이 몇개 존재하는지 반환하는 함수입니다.
+    // 다른 스레드의 insert(), erase_one()과 동시에 호출할수 있습니다.
+    // Pre : None.
+    // Post : bag에 있는 target의 개수를 반환. 없을 시 0 반환.
+    size_t count(const Item &target) const;
+
+    // insert() 함수는 현재 bag에 entry를 삽입하는 함수입니다.
+    // 가득 찬 노드는 내려가면서 미리 분할합니다.
+    // Pre : None.
+    // Post : bag에 entry가 추가된다.
+    void insert(const Item &entry);
+
+    // erase_one() 함수는 현재 bag에서 target 하나를 제거하는 함수입니다.
+    // 데이터가 MINIMUM개뿐인 노드는 내려가면서 미리 채웁니다.
+    // Pre : None.
+    // Post : bag에 target이 존재하면 삭제후 true 반환.
+    //        target이 존재하지 않으면 false 반환.
+    bool erase_one(const Item &target);
+
+    // size() 함수는 bag에 들어있는 데이터의 수를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : 호출한 시점에 완료된 삽입과 삭제를 반영한 데이터 수를 반환.
+    size_t size() const;
+
+    // empty() 함수는 bag이 비어있는지 확인하는 함수입니다.
+    // Pre : None.
+    // Post : size() == 0 이면 true 반환.
+    bool empty() const;
+
+    // clear() 함수는 현재 bag을 빈 bag으로 만드는 함수입니다.
+    // Pre : 다른 스레드가 이 bag을 사용하고 있지 않다.
+    // Post : 모든 노드를 해제하고 빈 리프노드 하나만 남긴다.
+    void clear();
+
+  private:
+    static_assert(MINIMUM >= 1, "concurrent_bag needs MINIMUM >= 1");
+
+    // 가득 찬 노드를 MINIMUM, 1, MINIMUM개로 나눌수 있도록 홀수로 한다
+    static const size_t MAXIMUM = 2 * MINIMUM + 1;
+
+    // 노드 안에서 데이터의 위치를 찾는 검색 커널
+    typedef typename bag_search_traits<Item>::type search;
+
+    struct node {
+        mutable std::shared_mutex latch; // 노드의 데이터와 자식을 보호
+        bool leaf;                       // 리프노드이면 true
+        size_t data_count;               // 현재 노드의 데이터 수
+        Item data[MAXIMUM];
+        node *child[MAXIMUM + 1];
+
+        explicit node(bool is_leaf);
+
+        // insert_data()는 data[i]에 entry를 삽입하고 뒤의 데이터를 한칸씩
+        // 미는 함수입니다.
+        // Pre : i <= data_count < MAXIMUM
+        void insert_data(size_t i, const Item &entry);
+
+        // remove_data()는 data[i]를 삭제하고 뒤의 데이터를 한칸씩 당기는
+        // 함수입니다.
+        // Pre : i < data_count
+        void remove_data(size_t i);
+
+        // insert_child()와 remove_child()는 자식 포인터 배열에 대해 같은
+        // 일을 하는 함수입니다. 자식의 수는 data_count + 1 이므로
+        // insert_child()는 insert_data()보다 먼저, remove_child()는
+        // remove_data()보다 나중에 호출합니다.
+        void insert_child(size_t i, node *c);
+        void remove_child(size_t i);
+    };
+
+    mutable std::shared_mutex root_latch; // root 포인터를 보호
+    node *root;                           // 최상위 노드. NULL이 아니다
+    std::atomic<size_t> item_count;       // bag에 들어있는 데이터의 수
+
+    // count()는 n을 루트로 하는 서브트리에서 target의 개수를 세는
+    // 함수입니다.
+    // Pre : 호출한 스레드가 n의 공유 latch를 잡고 있다.
+    // Post : 서브트리의 target의 개수를 반환하고 n의 latch를 놓는다.
+    size_t count(const node *n, const Item &target) const;
+
+    // split_child()는 가득 찬 n->child[i]를 둘로 나누는 함수입니다.
+    // Pre : n과 n->child[i]의 쓰기 latch를 잡고 있다. n은 가득 차지 않았고
+    //       n->child[i]는 가득 찼다.
+    // Post : child[i]의 가운데 데이터를 n의 data[i]로 올리고 뒤쪽 절반을 새
+    //        노드 child[i+1]로 옮긴다. 새 노드의 latch는 잡지 않는다.
+    void split_child(node *n, size_t i);
+
+    // prepare_child()는 erase에서 n->child[i]로 내려가기 전에 자식이
+    // MINIMUM개보다 많은 데이터를 가지도록 하는 함수입니다.
+    // Pre : n의 쓰기 latch를 잡고 있다. n이 최상위 노드가 아니라면 n의 데이터
+    //       수는 MINIMUM보다 많다.
+    // Post : 내려갈 자식의 쓰기 latch를 잡고 반환한다. 형제에게서 데이터를
+    //        받아오거나 형제와 merge 하므로 n의 데이터가 하나 줄어들수 있다.
+    node *prepare_child(node *n, size_t i);
+
+    // merge_child()는 n->child[i], n->data[i], n->child[i+1]을 child[i]
+    // 하나로 합치는 함수입니다.
+    // Pre : n, child[i], child[i+1]의 쓰기 latch를 잡고 있다. 두 자식의 데이터
+    //       수는 MINIMUM개이다.
+    // Post : child[i]가 2 * MINIMUM + 1 개의 데이터를 가지고 child[i+1]은
+    //        해제된다.
+    void merge_child(node *n, size_t i);
+
+    // take_biggest()와 take_smallest()는 n을 루트로 하는 서브트리에서 가장
+    // 크거나 작은 데이터를 꺼내는 함수입니다.
+    // Pre : n의 쓰기 latch를 잡고 있고 n의 데이터 수는 MINIMUM보다 많다.
+    // Post : 꺼낸 데이터를 반환하고, 지나간 노드의 latch는 모두 놓는다.
+    Item take_biggest(node *n);
+    Item take_smallest(node *n);
+
+    // destroy_tree()는 n을 루트로 하는 서브트리를 모두 해제하는 함수입니다.
+    // Pre : 다른 스레드가 서브트리를 사용하고 있지 않다.
+    // Post : 서브트리의 모든 노드가 해제된다.
+    static void destroy_tree(node *n);
+
+    concurrent_bag(const concurrent_bag &);
+    concurrent_bag &operator=(const concurrent_bag &);
+};
+
+template <class Item, size_t MINIMUM>
+concurrent_bag<Item, MINIMUM>::node::node(bool is_leaf) {
+    leaf = is_leaf;
+    data_count = 0;
+    for (size_t i = 0; i < MAXIMUM + 1; i++)
+        child[i] = NULL;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::node::insert_data(size_t i,
+                                                      const Item &entry) {
+    assert(i <= data_count && data_count < MAXIMUM); // Precondition
+
+    for (size_t j = data_count; j > i; j--)
+        data[j] = data[j - 1];
+    data[i] = entry;
+    data_count++;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::node::remove_data(size_t i) {
+    assert(i < data_count); // Precondition
+
+    data_count--;
+    for (; i < data_count; i++)
+        data[i] = data[i + 1];
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::node::insert_child(size_t i, node *c) {
+    // insert_data()보다 먼저 호출되므로 지금 자식의 수는 data_count + 1 이다
+    for (size_t j = data_count + 1; j > i; j--)
+        child[j] = child[j - 1];
+    child[i] = c;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::node::remove_child(size_t i) {
+    // remove_data()후에 호출되므로 남은 자식의 수는 data_count + 1 이다
+    for (; i <= data_count; i++)
+        child[i] = child[i + 1];
+    child[data_count + 1] = NULL;
+}
+
+template <class Item, size_t MINIMUM>
+concurrent_bag<Item, MINIMUM>::concurrent_bag() : item_count(0) {
+    root = new node(true);
+}
+
+template <class Item, size_t MINIMUM>
+concurrent_bag<Item, MINIMUM>::~concurrent_bag() {
+    destroy_tree(root);
+}
+
+template <class Item, size_t MINIMUM>
+size_t concurrent_bag<Item, MINIMUM>::count(const Item &target) const {
+    // 최상위 노드의 latch를 잡은 후에는 root가 바뀌어도 상관없다
+    root_latch.lock_shared();
+    const node *n = root;
+    n->latch.lock_shared();
+    root_latch.unlock_shared();
+
+    return count(n, target);
+}
+
+template <class Item, size_t MINIMUM>
+size_t concurrent_bag<Item, MINIMUM>::count(const node *n,
+                                            const Item &target) const {
+    size_t first = search::lower_bound(n->data, n->data_count, target);
+    size_t last = search::upper_bound(n->data, n->data_count, target);
+    size_t count = last - first;
+
+    if (n->leaf) {
+        n->latch.unlock_shared();
+        return count;
+    }
+
+    if (first == last) {
+        // target이 있을수 있는 자식이 하나뿐이면 자식의 latch를 잡은 후
+        // 바로 부모의 latch를 놓는다
+        const node *c = n->child[first];
+        c->latch.lock_shared();
+        n->latch.unlock_shared();
+        return count + this->count(c, target);
+    }
+
+    // 같은 데이터가 여러 자식에 걸쳐 있다면 모든 자식을 다 셀때까지 부모의
+    // latch를 잡고 있는다
+    for (size_t i = first; i <= last; i++) {
+        n->child[i]->latch.lock_shared();
+        count += this->count(n->child[i], target);
+    }
+    n->latch.unlock_shared();
+    return count;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::insert(const Item &entry) {
+    root_latch.lock();
+    node *n = root;
+    n->latch.lock();
+
+    if (n->data_count == MAXIMUM) {
+        // 최상위 노드가 가득 찼다면 새 최상위 노드를 만들고 분할한다. 새
+        // 노드는 root_latch를 놓기 전까지 다른 스레드가 찾아올수 없으므로,
+        // 부모에서 자식 순서로 latch를 잡도록 기존 루트의 latch를 먼저 놓는다.
+        node *new_root = new node(false);
+        new_root->child[0] = n;
+        split_child(new_root, 0);
+        root = new_root;
+        n->latch.unlock();
+        n = new_root;
+        n->latch.lock();
+    }
+    // 최상위 노드는 가득 차지 않았으므로 더이상 바뀌지 않는다
+    root_latch.unlock();
+
+    while (!n->leaf) {
+        size_t index = search::lower_bound(n->data, n->data_count, entry);
+        node *c = n->child[index];
+        c->latch.lock();
+
+        if (c->data_count == MAXIMUM) {
+            // 가득 찬 자식은 내려가기 전에 분할한다. n은 가득 차지 않았으므로
+            // 분할로 올라온 데이터를 받을수 있다.
+            split_child(n, index);
+            if (n->data[index] < entry) {
+                c->latch.unlock();
+                c = n->child[index + 1];
+                c->latch.lock();
+            }
+        }
+        n->latch.unlock();
+        n = c;
+    }
+
+    n->insert_data(search::lower_bound(n->data, n->data_count, entry), entry);
+    n->latch.unlock();
+    ++item_count;
+}
+
+template <class Item, size_t MINIMUM>
+bool concurrent_bag<Item, MINIMUM>::erase_one(const Item &target) {
+    root_latch.lock();
+    bool holding_root = true; // root_latch를 잡고 있는지
+    node *n = root;
+    n->latch.lock();
+
+    for (;;) {
+        // bag처럼 operator==가 아닌 operator<로 같은지 확인한다.
+        // lower_bound 위치의 데이터가 target보다 크지 않다면 target과 같다.
+        size_t index = search::lower_bound(n->data, n->data_count, target);
+        bool found = index < n->data_count && !(target < n->data[index]);
+        node *next;
+
+        if (found && n->leaf) {
+            n->remove_data(index);
+            break;
+        } else if (found) {
+            node *left = n->child[index];
+            left->latch.lock();
+            if (left->data_count > MINIMUM) {
+                // 왼쪽 서브트리의 가장 큰 데이터로 target을 덮어쓴다
+                n->data[index] = take_biggest(left);
+                break;
+            }
+            node *right = n->child[index + 1];
+            right->latch.lock();
+            if (right->data_count > MINIMUM) {
+                // 오른쪽 서브트리의 가장 작은 데이터로 target을 덮어쓴다
+                left->latch.unlock();
+                n->data[index] = take_smallest(right);
+                break;
+            }
+            // 두 자식 모두 MINIMUM개뿐이면 target과 함께 merge 한 후 merge된
+            // 자식에서 target을 삭제한다
+            merge_child(n, index);
+            next = left;
+        } else if (n->leaf) {
+            n->latch.unlock();
+            if (holding_root)
+                root_latch.unlock();
+            return false;
+        } else {
+            next = prepare_child(n, index);
+        }
+
+        if (holding_root && n->data_count == 0) {
+            // 최상위 노드의 마지막 데이터가 merge로 내려갔다면 유일한 자식을
+            // 최상위 노드로 삼는다. root_latch는 계속 잡고 있는다.
+            root = next;
+            n->latch.unlock();
+            delete n;
+        } else {
+            n->latch.unlock();
+            if (holding_root) {
+                root_latch.unlock();
+                holding_root = false;
+            }
+        }
+        n = next;
+    }
+
+    n->latch.unlock();
+    if (holding_root)
+        root_latch.unlock();
+    --item_count;
+    return true;
+}
+
+template <class Item, size_t MINIMUM>
+size_t concurrent_bag<Item, MINIMUM>::size() const {
+    return item_count.load();
+}
+
+template <class Item, size_t MINIMUM>
+bool concurrent_bag<Item, MINIMUM>::empty() const {
+    return item_count.load() == 0;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::clear() {
+    destroy_tree(root);
+    root = new node(true);
+    item_count = 0;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::split_child(node *n, size_t i) {
+    node *full = n->child[i];
+    assert(n->data_count < MAXIMUM);    // Precondition
+    assert(full->data_count == MAXIMUM); // Precondition
+
+    // 새 노드는 n의 latch를 잡고 있는 동안에는 다른 스레드가 찾아올수 없다
+    node *right = new node(full->leaf);
+    for (size_t j = 0; j < MINIMUM; j++)
+        right->data[j] = full->data[MINIMUM + 1 + j];
+    if (!full->leaf) {
+        for (size_t j = 0; j <= MINIMUM; j++) {
+            right->child[j] = full->child[MINIMUM + 1 + j];
+            full->child[MINIMUM + 1 + j] = NULL;
+        }
+    }
+    right->data_count = MINIMUM;
+    full->data_count = MINIMUM;
+
+    n->insert_child(i + 1, right);
+    n->insert_data(i, full->data[MINIMUM]);
+}
+
+template <class Item, size_t MINIMUM>
+typename concurrent_bag<Item, MINIMUM>::node *
+concurrent_bag<Item, MINIMUM>::prepare_child(node *n, size_t i) {
+    node *c = n->child[i];
+    c->latch.lock();
+    if (c->data_count > MINIMUM)
+        return c;
+
+    // 형제와 데이터를 주고받으려면 latch를 왼쪽 형제, c, 오른쪽 형제 순서로
+    // 다시 잡는다. n의 쓰기 latch를 잡고 있으므로 c의 자리는 그대로이지만,
+    // 먼저 c에 들어가 있던 스레드가 c의 데이터 수를 바꿨을수 있으므로 다시
+    // 확인한다.
+    c->latch.unlock();
+    node *left = (i > 0) ? n->child[i - 1] : NULL;
+    node *right = (i < n->data_count) ? n->child[i + 1] : NULL;
+    if (left != NULL)
+        left->latch.lock();
+    c->latch.lock();
+    if (right != NULL)
+        right->latch.lock();
+
+    if (c->data_count > MINIMUM) {
+        // 다시 확인해보니 채울 필요가 없다
+    } else if (left != NULL && left->data_count > MINIMUM) {
+        /* 왼쪽 형제에게 데이터를 하나 받아온다 */
+        size_t last = left->data_count - 1;
+        c->insert_child(0, left->child[last + 1]);
+        c->insert_data(0, n->data[i - 1]);
+        n->data[i - 1] = left->data[last];
+        left->child[last + 1] = NULL;
+        left->data_count--;
+    } else if (right != NULL && right->data_count > MINIMUM) {
+        /* 오른쪽 형제에게 데이터를 하나 받아온다 */
+        c->data[c->data_count] = n->data[i];
+        c->child[c->data_count + 1] = right->child[0];
+        c->data_count++;
+        n->data[i] = right->data[0];
+        right->remove_data(0);
+        right->remove_child(0);
+    } else if (left != NULL) {
+        // 양쪽 형제 모두 MINIMUM개뿐이면 merge 한다. merge_child()가 c의
+        // latch를 놓고 c를 해제한다.
+        if (right != NULL)
+            right->latch.unlock();
+        merge_child(n, i - 1);
+        return left;
+    } else {
+        merge_child(n, i);
+        return c;
+    }
+
+    if (left != NULL)
+        left->latch.unlock();
+    if (right != NULL)
+        right->latch.unlock();
+    return c;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::merge_child(node *n, size_t i) {
+    node *left = n->child[i];
+    node *right = n->child[i + 1];
+
+    // data[i]와 오른쪽 자식의 모든 데이터와 자식을 왼쪽 자식의 끝으로 옮긴다
+    left->data[left->data_count] = n->data[i];
+    for (size_t j = 0; j < right->data_count; j++)
+        left->data[left->data_count + 1 + j] = right->data[j];
+    if (!left->leaf) {
+        for (size_t j = 0; j <= right->data_count; j++)
+            left->child[left->data_count + 1 + j] = right->child[j];
+    }
+    left->data_count += right->data_count + 1;
+
+    n->remove_data(i);
+    n->remove_child(i + 1);
+
+    // n의 쓰기 latch를 잡고 있으므로 더이상 right를 찾아올 스레드는 없다
+    right->latch.unlock();
+    delete right;
+}
+
+template <class Item, size_t MINIMUM>
+Item concurrent_bag<Item, MINIMUM>::take_biggest(node *n) {
+    while (!n->leaf) {
+        node *c = prepare_child(n, n->data_count);
+        n->latch.unlock();
+        n = c;
+    }
+    Item biggest = n->data[n->data_count - 1];
+    n->data_count--;
+    n->latch.unlock();
+    return biggest;
+}
+
+template <class Item, size_t MINIMUM>
+Item concurrent_bag<Item, MINIMUM>::take_smallest(node *n) {
+    while (!n->leaf) {
+        node *c = prepare_child(n, 0);
+        n->latch.unlock();
+        n = c;
+    }
+    Item smallest = n->data[0];
+    n->remove_data(0);
+    n->latch.unlock();
+    return smallest;
+}
+
+template <class Item, size_t MINIMUM>
+void concurrent_bag<Item, MINIMUM>::destroy_tree(node *n) {
+    if (!n->leaf) {
+        for (size_t i = 0; i <= n->data_count; i++)
+            destroy_tree(n->child[i]);
+    }
+    delete n;
+}
+
+#endif
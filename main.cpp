@@ -1,10 +1,41 @@
 #include "bag.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
 #include <string>
+#include <vector>
 
 using namespace std;
 
-int main() {
-    bag<int> b;
+/* 인자 없이 실행하면 명령을 하나씩 입력받는 대화형 모드가 되고, --batch를 주면
+ * 파일이나 표준 입력의 명령들을 한번에 실행하는 batch 모드가 됩니다.
+ *
+ *   ./main                              대화형 모드
+ *   ./main --batch trace.txt [--show]   trace.txt의 명령을 실행
+ *   ./main --batch - [--show]           표준 입력의 명령을 실행
+ *
+ * batch 모드는 명령마다 트리를 출력하지 않고 count의 결과만 한줄에 하나씩
+ * 표준 출력에 씁니다. 명령에 show가 있으면 그 시점의 트리를 출력하고, --show를
+ * 주면 마지막에 트리를 출력합니다. 끝나면 명령 종류별 처리량을 표준 에러에
+ * 출력합니다. */
+
+// batch 모드의 명령 종류
+enum { INSERT, ERASE_ONE, COUNT, COMMAND_TYPES };
+
+// batch 모드는 같은 종류의 명령이 이어지면 최대 BLOCK_SIZE개까지 모아서 한번에
+// 시간을 잰다
+static const size_t BLOCK_SIZE = 4096;
+
+// command_stat은 batch 모드에서 명령 종류 하나의 실행 횟수와 시간입니다.
+struct command_stat {
+    const char *name;
+    size_t count;
+    size_t blocks;  // 시간을 잰 block의 수
+    double seconds; // bag 연산에 걸린 시간. 입력을 읽는 시간은 제외
+};
+
+static void interactive(bag<int> &b) {
     string command;
     int num;
 
@@ -20,7 +51,7 @@ int main() {
 
         cin >> command;
 
-        if (command.compare("quit") == 0) {
+        if (!cin || command.compare("quit") == 0) {
             break;
         } else if (command.compare("insert") && command.compare("count") &&
                    command.compare("erase_one")) {
@@ -52,6 +83,159 @@ int main() {
         b.show_contents();
         cout << endl;
     }
+}
+
+// run_block()은 종류가 type인 명령들의 인자 block을 차례로 실행하고 걸린
+// 시간을 stat에 더하는 함수입니다. 시계는 block마다 한번씩만 읽어서 시계를 읽는
+// 시간이 짧은 연산의 시간을 부풀리지 않게 한다. count의 결과는 results에 모아
+// 두었다가 시간을 잰 후 출력한다.
+static void run_block(bag<int> &b, int type, vector<int> &block,
+                      vector<size_t> &results, command_stat &stat) {
+    if (block.empty())
+        return;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (type == INSERT) {
+        for (size_t i = 0; i < block.size(); i++)
+            b.insert(block[i]);
+    } else if (type == ERASE_ONE) {
+        for (size_t i = 0; i < block.size(); i++)
+            b.erase_one(block[i]);
+    } else {
+        results.resize(block.size());
+        for (size_t i = 0; i < block.size(); i++)
+            results[i] = b.count(block[i]);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    stat.count += block.size();
+    stat.blocks++;
+    stat.seconds += elapsed.count();
+    if (type == COUNT)
+        for (size_t i = 0; i < results.size(); i++)
+            cout << results[i] << '\n';
+    block.clear();
+}
+
+// batch()는 in의 명령들을 끝까지 실행하는 함수입니다. 잘못된 줄은 건너뛰고
+// 그 수를 마지막에 알려준다.
+static void batch(bag<int> &b, istream &in, bool show) {
+    command_stat stats[COMMAND_TYPES] = {
+        {"insert", 0, 0, 0}, {"erase_one", 0, 0, 0}, {"count", 0, 0, 0}};
+    size_t skipped = 0;
+    string command;
+    int num;
+    int block_type = INSERT;
+    vector<int> block;
+    vector<size_t> results;
+    block.reserve(BLOCK_SIZE);
+    results.reserve(BLOCK_SIZE);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    while (in >> command) {
+        if (command == "quit")
+            break;
+        if (command == "show") {
+            run_block(b, block_type, block, results, stats[block_type]);
+            b.show_contents();
+            cout << '\n';
+            continue;
+        }
+
+        int type;
+        if (command == "insert")
+            type = INSERT;
+        else if (command == "erase_one")
+            type = ERASE_ONE;
+        else if (command == "count")
+            type = COUNT;
+        else
+            type = COMMAND_TYPES;
+
+        if (type == COMMAND_TYPES || !(in >> num)) {
+            skipped++;
+            in.clear();
+            in.ignore(numeric_limits<streamsize>::max(), '\n');
+            continue;
+        }
+
+        // 종류가 바뀌거나 block이 가득 차면 모아둔 명령을 먼저 실행한다
+        if (type != block_type || block.size() == BLOCK_SIZE) {
+            run_block(b, block_type, block, results, stats[block_type]);
+            block_type = type;
+        }
+        block.push_back(num);
+    }
+    run_block(b, block_type, block, results, stats[block_type]);
+    chrono::duration<double> total = chrono::steady_clock::now() - start;
 
+    if (show) {
+        cout << "<The current state of B-tree>" << '\n';
+        b.show_contents();
+    }
+    cout.flush();
+
+    // 처리량은 결과와 섞이지 않도록 표준 에러에 출력한다
+    size_t commands = 0, blocks = 0;
+    fprintf(stderr, "%-10s %12s %12s %14s\n", "command", "count", "seconds",
+            "ops/s");
+    for (int i = 0; i < COMMAND_TYPES; i++) {
+        commands += stats[i].count;
+        blocks += stats[i].blocks;
+        fprintf(stderr, "%-10s %12zu %12.3f %14.0f\n", stats[i].name,
+                stats[i].count, stats[i].seconds,
+                stats[i].seconds > 0 ? stats[i].count / stats[i].seconds : 0);
+    }
+    // 전체 시간은 입력을 읽고 결과를 쓰는 시간을 포함한다
+    fprintf(stderr, "%-10s %12zu %12.3f %14.0f\n", "total", commands,
+            total.count(),
+            total.count() > 0 ? commands / total.count() : 0);
+    // 종류가 자주 바뀌면 block이 짧아져 시계를 읽는 시간이 무시할수 없어진다
+    if (blocks > 0 && commands < 64 * blocks)
+        fprintf(stderr,
+                "commands alternate often (%.1f per timed block); per-type "
+                "seconds include clock overhead\n",
+                double(commands) / blocks);
+    if (skipped > 0)
+        fprintf(stderr, "skipped %zu malformed commands\n", skipped);
+    fprintf(stderr, "bag size %zu\n", b.size());
+}
+
+int main(int argc, char **argv) {
+    bag<int> b;
+    const char *batch_path = NULL;
+    bool show = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (arg == "--show") {
+            show = true;
+        } else {
+            fprintf(stderr, "usage: %s [--batch FILE|- [--show]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (batch_path == NULL) {
+        interactive(b);
+        return 0;
+    }
+
+    // batch 모드에서는 C 입출력과의 동기화를 끄고 출력을 버퍼에 모은다
+    ios::sync_with_stdio(false);
+    cin.tie(NULL);
+
+    if (string(batch_path) == "-") {
+        batch(b, cin, show);
+    } else {
+        ifstream file(batch_path);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", batch_path);
+            return 1;
+        }
+        batch(b, file, show);
+    }
     return 0;
 }
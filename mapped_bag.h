@@ -0,0 +1,393 @@
+#ifndef MAPPED_BAG_H
+#define MAPPED_BAG_H
+
+#include "bag_file.h"
+#include "bag_search.h"
+#include <cassert>
+#include <cstddef>
+#include <fcntl.h>
+#include <iterator>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+/* mapped_bag은 bag::save()로 저장한 파일을 mmap 해서 읽기 전용으로 사용하는
+ * bag입니다. open_mapped()는 헤더만 검사하고 파일 전체를 메모리에 올리거나
+ * 노드를 만들지 않으므로, 데이터의 양과 상관없이 바로 열립니다. count(),
+ * count_range(), 순회는 페이지 캐시에 있는 페이지를 직접 읽습니다.
+ *
+ * 매핑은 읽기 전용이므로 insert()와 erase는 제공하지 않습니다. 데이터를 바꾸려면
+ * thaw()로 일반 bag에 옮긴 후 바꾸고 다시 save() 합니다. */
+
+template <class Item> class mapped_bag {
+  public:
+    // Default Constructor. 열린 파일이 없는 빈 bag을 만든다.
+    mapped_bag();
+
+    // Destructor
+    ~mapped_bag();
+
+    // open_mapped() 함수는 path의 파일을 읽기 전용으로 mmap 하는 함수입니다.
+    // 이미 열린 파일이 있다면 먼저 닫습니다.
+    // Pre : None.
+    // Post : 파일이 같은 Item 크기와 바이트 순서로 저장된 bag 파일이면 true
+    //        반환. 아니라면 false를 반환하고 빈 bag이 된다.
+    bool open_mapped(const char *path);
+
+    // close() 함수는 매핑을 해제하는 함수입니다.
+    // Pre : None.
+    // Post : 빈 bag이 된다. 기존의 반복자는 사용할수 없다.
+    void close();
+
+    // count() 함수는 target이 몇개 존재하는지 반환하는 함수입니다.
+    // Pre : None.
+    // Post : target의 개수를 반환. 없을 시 0 반환.
+    size_t count(const Item &target) const;
+
+    // rank() 함수는 target보다 작은 데이터의 수를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : x < target 인 데이터 x의 수를 반환.
+    size_t rank(const Item &target) const;
+
+    // count_range() 함수는 lo 이상 hi 이하인 데이터의 수를 세는 함수입니다.
+    // 내부 페이지의 서브트리 데이터 수를 이용하므로 두번만 내려갑니다.
+    // Pre : None.
+    // Post : lo <= x <= hi 인 데이터 x의 수를 반환. hi < lo 이면 0 반환.
+    size_t count_range(const Item &lo, const Item &hi) const;
+
+    // size() 함수는 데이터의 수를 반환하는 함수입니다.
+    // Pre : None.
+    // Post : 같은 데이터도 각각 세어서 반환.
+    size_t size() const;
+
+    // empty() 함수는 bag이 비어있는지 확인하는 함수입니다.
+    // Pre : None.
+    // Post : 비어있으면 true 반환.
+    bool empty() const;
+
+    // const_iterator는 리프 페이지를 next로 따라가면서 데이터를 오름차순으로
+    // 순회하는 반복자입니다. 같은 데이터는 그 개수만큼 반복해서 방문합니다.
+    class const_iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Item value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Item *pointer;
+        typedef const Item &reference;
+
+        // Default Constructor. end()와 같은 반복자를 만든다.
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+      private:
+        friend class mapped_bag;
+
+        const mapped_bag *owner;
+        const void *leaf; // 현재 리프 페이지. NULL이면 end()
+        size_t slot;      // 리프 페이지 안에서의 위치
+        uint64_t rep;     // 현재 데이터를 방문한 횟수
+
+        // settle()은 slot이 리프의 끝을 넘었다면 다음 리프로 넘어가는
+        // 함수입니다.
+        void settle();
+    };
+    typedef const_iterator iterator;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // lower_bound()와 upper_bound()는 target 이상, target 초과인 첫 데이터를
+    // 찾는 함수입니다.
+    // Pre : None.
+    // Post : 찾은 데이터의 반복자를 반환. 없으면 end() 반환.
+    const_iterator lower_bound(const Item &target) const;
+    const_iterator upper_bound(const Item &target) const;
+
+    // thaw() 함수는 모든 데이터를 일반 bag에 옮기는 함수입니다. 데이터가
+    // 정렬되어 있으므로 bag의 assign()이 트리를 O(n)에 만든다.
+    // Pre : Bag은 assign(first, last)를 가진 bag 타입.
+    // Post : b의 데이터가 이 bag의 데이터로 바뀐다.
+    template <class Bag> void thaw(Bag &b) const;
+
+  private:
+    typedef bag_page_layout<Item> layout;
+    typedef typename bag_search_traits<Item>::type search;
+
+    const char *base; // 매핑의 시작 주소. 열린 파일이 없다면 NULL
+    size_t length;    // 매핑의 크기
+    const bag_file_header *header;
+
+    // page()는 페이지 번호 i의 주소를 반환하는 함수입니다.
+    const void *page(uint64_t i) const;
+
+    // find_leaf()는 target의 lower_bound 또는 upper_bound가 있는 리프
+    // 페이지까지 내려가는 함수입니다. before에는 그 리프 앞에 있는 데이터의
+    // 수를 더한다.
+    // Pre : 열린 파일이 있고 비어있지 않다.
+    // Post : 리프 페이지와 그 안에서의 위치(리프의 끝일수 있음)를 반환.
+    std::pair<const void *, size_t> find_leaf(const Item &target, bool upper,
+                                              uint64_t &before) const;
+
+    // rank_bound()는 target보다 작은(upper이면 작거나 같은) 데이터의 수를
+    // 반환하는 함수입니다.
+    size_t rank_bound(const Item &target, bool upper) const;
+
+    mapped_bag(const mapped_bag &);
+    mapped_bag &operator=(const mapped_bag &);
+};
+
+template <class Item>
+mapped_bag<Item>::mapped_bag() : base(NULL), length(0), header(NULL) {}
+
+template <class Item> mapped_bag<Item>::~mapped_bag() {
+    close();
+}
+
+template <class Item> bool mapped_bag<Item>::open_mapped(const char *path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)BAG_PAGE_SIZE) {
+        ::close(fd);
+        return false;
+    }
+
+    // 매핑은 파일을 닫아도 유지된다
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    base = static_cast<const char *>(mapped);
+    length = st.st_size;
+    header = reinterpret_cast<const bag_file_header *>(base);
+
+    // 다른 Item이나 다른 기계에서 저장한 파일은 거부한다
+    if (memcmp(header->magic, "BAGFILE", 8) != 0 || header->version != 1 ||
+        header->byte_order != 0x01020304 ||
+        header->page_size != BAG_PAGE_SIZE ||
+        header->item_size != sizeof(Item) ||
+        header->page_count * BAG_PAGE_SIZE != length ||
+        header->root >= header->page_count ||
+        header->first_leaf >= header->page_count) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+template <class Item> void mapped_bag<Item>::close() {
+    if (base != NULL)
+        munmap(const_cast<char *>(base), length);
+    base = NULL;
+    length = 0;
+    header = NULL;
+}
+
+template <class Item>
+size_t mapped_bag<Item>::count(const Item &target) const {
+    if (empty())
+        return 0;
+
+    uint64_t before = 0;
+    std::pair<const void *, size_t> pos = find_leaf(target, false, before);
+    const void *leaf = pos.first;
+    if (pos.second < layout::header(leaf)->count &&
+        !(target < layout::leaf_keys(leaf)[pos.second]))
+        return layout::leaf_counts(leaf)[pos.second];
+    return 0;
+}
+
+template <class Item>
+size_t mapped_bag<Item>::rank(const Item &target) const {
+    return rank_bound(target, false);
+}
+
+template <class Item>
+size_t mapped_bag<Item>::count_range(const Item &lo, const Item &hi) const {
+    if (hi < lo)
+        return 0;
+    return rank_bound(hi, true) - rank_bound(lo, false);
+}
+
+template <class Item> size_t mapped_bag<Item>::size() const {
+    return header == NULL ? 0 : header->item_count;
+}
+
+template <class Item> bool mapped_bag<Item>::empty() const {
+    return size() == 0;
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator mapped_bag<Item>::begin() const {
+    const_iterator it;
+    if (!empty()) {
+        it.owner = this;
+        it.leaf = page(header->first_leaf);
+    }
+    return it;
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator mapped_bag<Item>::end() const {
+    return const_iterator();
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator
+mapped_bag<Item>::lower_bound(const Item &target) const {
+    const_iterator it;
+    if (!empty()) {
+        uint64_t before = 0;
+        std::pair<const void *, size_t> pos = find_leaf(target, false, before);
+        it.owner = this;
+        it.leaf = pos.first;
+        it.slot = pos.second;
+        it.settle();
+    }
+    return it;
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator
+mapped_bag<Item>::upper_bound(const Item &target) const {
+    const_iterator it;
+    if (!empty()) {
+        uint64_t before = 0;
+        std::pair<const void *, size_t> pos = find_leaf(target, true, before);
+        it.owner = this;
+        it.leaf = pos.first;
+        it.slot = pos.second;
+        it.settle();
+    }
+    return it;
+}
+
+template <class Item>
+template <class Bag>
+void mapped_bag<Item>::thaw(Bag &b) const {
+    b.assign(begin(), end());
+}
+
+template <class Item> const void *mapped_bag<Item>::page(uint64_t i) const {
+    assert(i < header->page_count);
+    return base + i * BAG_PAGE_SIZE;
+}
+
+template <class Item>
+std::pair<const void *, size_t>
+mapped_bag<Item>::find_leaf(const Item &target, bool upper,
+                            uint64_t &before) const {
+    const void *p = page(header->root);
+
+    // key[i]는 child[i+1]의 가장 작은 데이터이므로, target과 같은 구분
+    // 데이터가 있다면 그 오른쪽 자식으로 내려가야 target의 첫 위치를 찾는다.
+    // 리프에는 같은 데이터가 한번만 있으므로 upper_bound도 같은 자식에 있다.
+    while (!layout::header(p)->leaf) {
+        size_t children = layout::header(p)->count;
+        size_t i = search::upper_bound(layout::internal_keys(p), children - 1,
+                                       target);
+        const uint64_t *totals = layout::totals(p);
+        for (size_t j = 0; j < i; j++)
+            before += totals[j];
+        p = page(layout::children(p)[i]);
+    }
+
+    size_t count = layout::header(p)->count;
+    size_t slot =
+        upper ? search::upper_bound(layout::leaf_keys(p), count, target)
+              : search::lower_bound(layout::leaf_keys(p), count, target);
+    const uint64_t *counts = layout::leaf_counts(p);
+    for (size_t j = 0; j < slot; j++)
+        before += counts[j];
+    return std::make_pair(p, slot);
+}
+
+template <class Item>
+size_t mapped_bag<Item>::rank_bound(const Item &target, bool upper) const {
+    if (empty())
+        return 0;
+    uint64_t before = 0;
+    find_leaf(target, upper, before);
+    return before;
+}
+
+template <class Item>
+mapped_bag<Item>::const_iterator::const_iterator()
+    : owner(NULL), leaf(NULL), slot(0), rep(0) {}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator::reference
+mapped_bag<Item>::const_iterator::operator*() const {
+    assert(leaf != NULL); // Precondition
+    return layout::leaf_keys(leaf)[slot];
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator::pointer
+mapped_bag<Item>::const_iterator::operator->() const {
+    return &**this;
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator &
+mapped_bag<Item>::const_iterator::operator++() {
+    assert(leaf != NULL); // Precondition
+
+    // 같은 데이터를 그 개수만큼 방문한 후 다음 자리로 넘어간다
+    if (++rep < layout::leaf_counts(leaf)[slot])
+        return *this;
+    ++slot;
+    settle();
+    return *this;
+}
+
+template <class Item>
+typename mapped_bag<Item>::const_iterator
+mapped_bag<Item>::const_iterator::operator++(int) {
+    const_iterator old = *this;
+    ++*this;
+    return old;
+}
+
+template <class Item>
+bool mapped_bag<Item>::const_iterator::operator==(
+    const const_iterator &other) const {
+    if (leaf == NULL || other.leaf == NULL)
+        return leaf == other.leaf;
+    return leaf == other.leaf && slot == other.slot && rep == other.rep;
+}
+
+template <class Item>
+bool mapped_bag<Item>::const_iterator::operator!=(
+    const const_iterator &other) const {
+    return !(*this == other);
+}
+
+template <class Item> void mapped_bag<Item>::const_iterator::settle() {
+    rep = 0;
+    if (slot < layout::header(leaf)->count)
+        return;
+
+    // 리프의 끝이라면 다음 리프의 첫 데이터로 넘어간다. 리프는 비어있지
+    // 않으므로 한번만 넘어가면 된다.
+    uint64_t next = layout::header(leaf)->next;
+    slot = 0;
+    leaf = (next == 0) ? NULL : owner->page(next);
+}
+
+#endif